@@ -6,17 +6,26 @@
 #pragma warning( push )
 #pragma warning( disable : 4996)
 
+/* localtime() returns a shared static buffer, this one is safe to call from any thread */
+void local_time(time_t rawtime, struct tm& result) {
+#ifdef _WIN32
+	localtime_s(&result, &rawtime);
+#else
+	localtime_r(&rawtime, &result);
+#endif
+}
+
 std::string get_time_string(int timestamp) {
 	const time_t rawtime = timestamp;
-	struct tm * dt;
+	struct tm dt;
 	char timestr[30];
 	char buffer[30];
 
 
-	dt = localtime(&rawtime);
+	local_time(rawtime, dt);
 	// use any strftime format spec here
-	strftime(timestr, sizeof(timestr), "%d.%m.%Y %H:%M:%S", dt);
-	sprintf_s(buffer, "%s", timestr);
+	strftime(timestr, sizeof(timestr), "%d.%m.%Y %H:%M:%S", &dt);
+	snprintf(buffer, sizeof(buffer), "%s", timestr);
 
 	return buffer;
 }
@@ -43,6 +52,33 @@ std::vector<std::string> split(std::string strToSplit, char delimeter)
 	return splittedStrings;
 }
 
+/*
+64-bit FNV-1a hash, used to detect whether a fetched value actually changed.
+*/
+
+unsigned long long hash_string(const char* data, size_t length)
+{
+	unsigned long long hash = 14695981039346656037ull;
+	for (size_t i = 0; i < length; i++) {
+		hash ^= (unsigned char)data[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+/* "45 sec", "12 min", "3 h", "2 days" */
+std::string age_string(long long seconds)
+{
+	if (seconds < 0) seconds = 0;
+	if (seconds < 60) return std::to_string(seconds) + " sec";
+	if (seconds < 60 * 60) return std::to_string(seconds / 60) + " min";
+	if (seconds < 48 * 60 * 60) return std::to_string(seconds / 60 / 60) + " h";
+	return std::to_string(seconds / 60 / 60 / 24) + " days";
+}
+
+/* Allocator bookkeeping and links of one map node, a rough figure for memory estimates */
+#define MAP_NODE_OVERHEAD (4 * sizeof(void*))
+
 //char checkmark(char* variable) {
 //	char ad;
 //	if (variable == "1") {
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+#include "utf8_file.h"
+
+/*
+Format, dimensions and file size of a client's avatar, read from the header of the file the client downloaded.
+Nothing is decoded: PNG, GIF, BMP and WebP keep their size in the first AVATAR_HEADER_BYTES, JPEG is walked segment
+by segment up to the frame header, seeking over everything else.
+
+Results are kept by avatar hash (CLIENT_FLAG_AVATAR), so each distinct avatar is inspected once, whoever uses it.
+An avatar that is not downloaded yet is not kept; onAvatarUpdated refreshes the panel once it is.
+*/
+
+#define AVATAR_HEADER_BYTES 32
+#define AVATAR_MAX_JPEG_SEGMENTS 64
+#define AVATAR_CACHE_MAX 4096
+
+struct avatar_info {
+	const char* format;  /* NULL if not recognized */
+	unsigned int width;
+	unsigned int height;
+	unsigned long long file_size;
+};
+
+static std::map<std::string, avatar_info> avatar_infos;
+static std::mutex avatar_infos_mutex;
+
+static unsigned int avatar_le16(const unsigned char* p) { return p[0] | (p[1] << 8); }
+static unsigned int avatar_be16(const unsigned char* p) { return (p[0] << 8) | p[1]; }
+static unsigned int avatar_le24(const unsigned char* p) { return p[0] | (p[1] << 8) | (p[2] << 16); }
+static unsigned int avatar_le32(const unsigned char* p) { return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24); }
+static unsigned int avatar_be32(const unsigned char* p) { return ((unsigned int)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3]; }
+
+/* Walks the segments after SOI until a start of frame marker. Only segment headers are read. */
+static bool avatar_jpeg_size(FILE* file, avatar_info& info) {
+	if (fseek(file, 2, SEEK_SET) != 0) return false;
+	for (int segment = 0; segment < AVATAR_MAX_JPEG_SEGMENTS; segment++) {
+		int c = fgetc(file);
+		if (c != 0xFF) return false;
+		do c = fgetc(file); while (c == 0xFF);  /* fill bytes */
+		if (c == EOF || c == 0xD9 || c == 0xDA) return false;  /* end of image or scan data before any frame */
+		if (c == 0x01 || (c >= 0xD0 && c <= 0xD7)) continue;  /* markers without a length */
+		unsigned char header[7];
+		if (fread(header, 1, 2, file) != 2) return false;
+		unsigned int length = avatar_be16(header);
+		if (length < 2) return false;
+		if (c >= 0xC0 && c <= 0xCF && c != 0xC4 && c != 0xC8 && c != 0xCC) {
+			if (length < 7 || fread(header + 2, 1, 5, file) != 5) return false;
+			info.height = avatar_be16(header + 3);
+			info.width = avatar_be16(header + 5);
+			return true;
+		}
+		if (fseek(file, length - 2, SEEK_CUR) != 0) return false;
+	}
+	return false;
+}
+
+static void avatar_inspect(FILE* file, avatar_info& info) {
+	unsigned char header[AVATAR_HEADER_BYTES] = { 0 };
+	size_t read = fread(header, 1, sizeof(header), file);
+	if (read >= 24 && memcmp(header, "\x89PNG\r\n\x1a\n", 8) == 0 && memcmp(header + 12, "IHDR", 4) == 0) {
+		info.format = "PNG";
+		info.width = avatar_be32(header + 16);
+		info.height = avatar_be32(header + 20);
+	}
+	else if (read >= 10 && (memcmp(header, "GIF87a", 6) == 0 || memcmp(header, "GIF89a", 6) == 0)) {
+		info.format = "GIF";
+		info.width = avatar_le16(header + 6);
+		info.height = avatar_le16(header + 8);
+	}
+	else if (read >= 26 && header[0] == 'B' && header[1] == 'M') {
+		int height = (int)avatar_le32(header + 22);  /* negative for top-down bitmaps */
+		info.format = "BMP";
+		info.width = avatar_le32(header + 18);
+		info.height = height < 0 ? (unsigned int)-height : (unsigned int)height;
+	}
+	else if (read >= 30 && memcmp(header, "RIFF", 4) == 0 && memcmp(header + 8, "WEBP", 4) == 0) {
+		info.format = "WebP";
+		if (memcmp(header + 12, "VP8 ", 4) == 0) {
+			info.width = avatar_le16(header + 26) & 0x3FFF;
+			info.height = avatar_le16(header + 28) & 0x3FFF;
+		}
+		else if (memcmp(header + 12, "VP8L", 4) == 0) {
+			unsigned int bits = avatar_le32(header + 21);
+			info.width = (bits & 0x3FFF) + 1;
+			info.height = ((bits >> 14) & 0x3FFF) + 1;
+		}
+		else if (memcmp(header + 12, "VP8X", 4) == 0) {
+			info.width = avatar_le24(header + 24) + 1;
+			info.height = avatar_le24(header + 27) + 1;
+		}
+	}
+	else if (read >= 3 && header[0] == 0xFF && header[1] == 0xD8 && header[2] == 0xFF) {
+		info.format = "JPEG";
+		avatar_jpeg_size(file, info);
+	}
+	if (fseek(file, 0, SEEK_END) == 0) {
+		long size = ftell(file);
+		if (size > 0) info.file_size = (unsigned long long)size;
+	}
+}
+
+/* "PNG, 128 x 128, 12.30 KBYTE" */
+static std::string avatar_info_string(const avatar_info& info) {
+	std::string result = info.format ? info.format : "unknown format";
+	if (info.width && info.height) result += ", " + std::to_string(info.width) + " x " + std::to_string(info.height);
+	return result + ", " + size_string(info.file_size);
+}
+
+std::string avatar_string(uint64 serverConnectionHandlerID, anyID clientID, const std::string& hash) {
+	if (hash.empty()) return "none";
+	{
+		std::lock_guard<std::mutex> lock(avatar_infos_mutex);
+		std::map<std::string, avatar_info>::const_iterator it = avatar_infos.find(hash);
+		if (it != avatar_infos.end()) return avatar_info_string(it->second);
+	}
+
+	char path[PATH_BUFSIZE];
+	path[0] = '\0';
+	if (ts3Functions.getAvatar(serverConnectionHandlerID, clientID, path, PATH_BUFSIZE) != ERROR_ok || !path[0]) return "not downloaded yet";
+	FILE* file = utf8_fopen(path, "rb");
+	if (!file) return "not downloaded yet";
+	avatar_info info = { NULL, 0, 0, 0 };
+	avatar_inspect(file, info);
+	fclose(file);
+
+	std::lock_guard<std::mutex> lock(avatar_infos_mutex);
+	if (avatar_infos.size() >= AVATAR_CACHE_MAX) avatar_infos.clear();
+	avatar_infos[hash] = info;
+	return avatar_info_string(info);
+}
+
+/* The client downloaded a new avatar file; an entry made from the previous file under the new hash must go */
+void avatar_updated(uint64 serverConnectionHandlerID, anyID clientID) {
+	char* hash;
+	if (ts3Functions.getClientVariableAsString(serverConnectionHandlerID, clientID, CLIENT_FLAG_AVATAR, &hash) == ERROR_ok) {
+		{
+			std::lock_guard<std::mutex> lock(avatar_infos_mutex);
+			avatar_infos.erase(hash);
+		}
+		ts3Functions.freeMemory(hash);
+	}
+	ts3Functions.requestInfoUpdate(serverConnectionHandlerID, PLUGIN_CLIENT, clientID);
+}
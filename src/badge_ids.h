@@ -1,9 +1,14 @@
 #pragma once
 #include <map>
+#include <memory>
 #include <string>
 
-std::map<std::string, std::string> guids;
+/* Built once and published as a whole; readers never modify it, so they need no lock */
+static std::shared_ptr<const std::map<std::string, std::string> > guids;
+
 void init_guids() {
+	std::shared_ptr<std::map<std::string, std::string> > names = std::make_shared<std::map<std::string, std::string> >();
+	std::map<std::string, std::string>& guids = *names;
 	guids.insert(std::pair<std::string, std::string>("1cb07348-34a4-4741-b50f-c41e584370f7", "Creator of TeamSpeak Addons"));
 	guids.insert(std::pair<std::string, std::string>("50bbdbc8-0f2a-46eb-9808-602225b49627", "Registered during Gamescom 2016"));
 	guids.insert(std::pair<std::string, std::string>("d95f9901-c42d-4bac-8849-7164fd9e2310", "Registered during Paris Games Week 2016"));
@@ -24,11 +29,12 @@ void init_guids() {
 	guids.insert(std::pair<std::string, std::string>("24512806-f886-4440-b579-9e26e4219ef6", "Gamescom Exclusive Gaming Hero 2018"));
 	guids.insert(std::pair<std::string, std::string>("b9c7d6ad-5b99-40fb-988c-1d02ab6cc130", "Found Tim Speak at Gamescom 2018"));
 	guids.insert(std::pair<std::string, std::string>("6b187e83-873b-46b0-b2c2-a31af15e76a4", "TeamSpeak Merch Owner - 1st Edition"));
+	std::atomic_store(&::guids, std::shared_ptr<const std::map<std::string, std::string> >(names));
 }
 
-std::string guid_name(std::string guid) {
-	std::string guid_name;
-	guid_name = guids[guid];
-
-	return guid_name;
-}
\ No newline at end of file
+std::string guid_name(const std::string& guid) {
+	std::shared_ptr<const std::map<std::string, std::string> > names = std::atomic_load(&guids);
+	if (!names) return "";
+	std::map<std::string, std::string>::const_iterator it = names->find(guid);
+	return it == names->end() ? "" : it->second;
+}
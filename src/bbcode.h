@@ -0,0 +1,71 @@
+#pragma once
+
+#include <string>
+
+#include "simd.h"
+
+/*
+Escaping of untrusted text (nicknames, messages, descriptions, file names) before it goes into the BBCode of the
+info panel. A zero width space after every '[' keeps the client from reading a tag there while the text looks the
+same; a ']' cannot open a tag and stays. Line breaks and tabs stay, other control characters are dropped.
+
+Clean runs are found 16 bytes at a time (SSE2, see simd.h) and appended in one piece.
+*/
+
+#define BBCODE_TAG_BREAK "\xE2\x80\x8B"  /* U+200B */
+
+static bool bbcode_special(unsigned char c) {
+	return c == '[' || c < 0x20 || c == 0x7F;
+}
+
+#ifdef KMI_HAVE_SSE2
+static int bbcode_lowest_bit(int mask) {
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, (unsigned long)mask);
+	return (int)index;
+#else
+	return __builtin_ctz((unsigned int)mask);
+#endif
+}
+#endif
+
+/* Appends the clean run before the special character at i and the character's replacement */
+template <typename output> void bbcode_escape_at(const char* value, size_t& run, size_t i, output& out) {
+	out.append(value + run, i - run);
+	char c = value[i];
+	if (c == '[') out += "[" BBCODE_TAG_BREAK;
+	else if (c == '\n' || c == '\t') out += c;
+	run = i + 1;
+}
+
+/* Appends the escaped value to out, a std::string or the pool_string of a panel being rendered */
+template <typename output> void bbcode_escape_append(const char* value, size_t length, output& out) {
+	out.reserve(out.size() + length);
+	size_t run = 0;  /* start of the clean run not appended yet */
+	size_t i = 0;
+#ifdef KMI_HAVE_SSE2
+	const __m128i open = _mm_set1_epi8('[');
+	const __m128i del = _mm_set1_epi8(0x7F);
+	const __m128i control = _mm_set1_epi8(0x1F);
+	for (; i + 16 <= length; i += 16) {
+		__m128i bytes = _mm_loadu_si128((const __m128i*)(value + i));
+		/* min_epu8 compares unsigned, so UTF-8 bytes never count as control characters */
+		__m128i special = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(bytes, open), _mm_cmpeq_epi8(bytes, del)),
+			_mm_cmpeq_epi8(_mm_min_epu8(bytes, control), bytes));
+		/* Every special character of the block from the one mask, dense text is not loaded again per character */
+		for (int mask = _mm_movemask_epi8(special); mask; mask &= mask - 1)
+			bbcode_escape_at(value, run, i + bbcode_lowest_bit(mask), out);
+	}
+#endif
+	for (; i < length; i++) {
+		if (bbcode_special((unsigned char)value[i])) bbcode_escape_at(value, run, i, out);
+	}
+	out.append(value + run, length - run);
+}
+
+std::string bbcode_escape(const std::string& value) {
+	std::string result;
+	bbcode_escape_append(value.data(), value.size(), result);
+	return result;
+}
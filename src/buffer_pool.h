@@ -0,0 +1,176 @@
+#pragma once
+
+#include <mutex>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+/*
+Recycles the infoData output buffers. The client hands every buffer back through ts3plugin_freeMemory, and the info
+frame is refreshed all the time, so buffers go to a free list per power of two size class instead of back to the heap.
+Free buffers are kept up to POOL_MAX_RETAINED_BYTES in total; larger requests bypass the pool.
+Only buffers from pool_alloc may be passed to pool_free, ts3plugin_freeMemory gets nothing else.
+
+The panels are rendered straight into a pooled buffer (pool_string) that is handed to the client as it is.
+*/
+
+#define POOL_MIN_CLASS_SHIFT 8   /* 256 bytes */
+#define POOL_CLASSES 9           /* up to 64 KB */
+#define POOL_OVERSIZE POOL_CLASSES
+#define POOL_MAX_RETAINED_BYTES (512 * 1024)
+
+/* Sits in front of every buffer handed out, keeps the data 16 byte aligned */
+struct alignas(16) pool_header {
+	unsigned int size_class;
+	void* next;  /* free list link while the buffer is in the pool */
+};
+
+struct pool_stats {
+	unsigned long long reused;
+	unsigned long long allocated;
+	unsigned long long oversize;
+	unsigned long long released;  /* returned while the pool was full */
+	size_t retained_bytes;
+	size_t retained_peak;
+};
+
+static pool_header* pool_free_lists[POOL_CLASSES];
+static pool_stats buffer_pool_stats;
+static std::mutex buffer_pool_mutex;
+
+static size_t pool_class_size(unsigned int size_class) {
+	return (size_t)1 << (size_class + POOL_MIN_CLASS_SHIFT);
+}
+
+static unsigned int pool_size_class(size_t size) {
+	unsigned int size_class = 0;
+	while (size_class < POOL_CLASSES && pool_class_size(size_class) < size) size_class++;
+	return size_class;
+}
+
+char* pool_alloc(size_t size) {
+	unsigned int size_class = pool_size_class(size);
+	pool_header* header = NULL;
+	{
+		std::lock_guard<std::mutex> lock(buffer_pool_mutex);
+		if (size_class == POOL_OVERSIZE) {
+			buffer_pool_stats.oversize++;
+		}
+		else if (pool_free_lists[size_class]) {
+			header = pool_free_lists[size_class];
+			pool_free_lists[size_class] = (pool_header*)header->next;
+			buffer_pool_stats.retained_bytes -= pool_class_size(size_class);
+			buffer_pool_stats.reused++;
+		}
+		else {
+			buffer_pool_stats.allocated++;
+		}
+	}
+	if (!header) {
+		header = (pool_header*)malloc(sizeof(pool_header) + (size_class == POOL_OVERSIZE ? size : pool_class_size(size_class)));
+		if (!header) return NULL;
+		header->size_class = size_class;
+	}
+	header->next = NULL;
+	return (char*)(header + 1);
+}
+
+void pool_free(void* data) {
+	if (!data) return;
+	pool_header* header = (pool_header*)data - 1;
+	if (header->size_class != POOL_OVERSIZE) {
+		std::lock_guard<std::mutex> lock(buffer_pool_mutex);
+		size_t size = pool_class_size(header->size_class);
+		if (buffer_pool_stats.retained_bytes + size <= POOL_MAX_RETAINED_BYTES) {
+			header->next = pool_free_lists[header->size_class];
+			pool_free_lists[header->size_class] = header;
+			buffer_pool_stats.retained_bytes += size;
+			if (buffer_pool_stats.retained_bytes > buffer_pool_stats.retained_peak) buffer_pool_stats.retained_peak = buffer_pool_stats.retained_bytes;
+			return;
+		}
+		buffer_pool_stats.released++;
+	}
+	free(header);
+}
+
+/* Bytes usable in the buffer pool_alloc returns for size */
+static size_t pool_usable_size(size_t size) {
+	unsigned int size_class = pool_size_class(size);
+	return size_class == POOL_OVERSIZE ? size : pool_class_size(size_class);
+}
+
+/*
+Text built in place in a pooled buffer, with as much of the std::string interface as render_layout and
+bbcode_escape_append use. Growing moves the text to a buffer of the next fitting size class.
+*/
+struct pool_string {
+	char* data;
+	size_t length;
+	size_t capacity;  /* without the terminator */
+	bool failed;      /* out of memory, release() returns NULL */
+
+	explicit pool_string(size_t reserved) : data(NULL), length(0), capacity(0), failed(false) { reserve(reserved); }
+	~pool_string() { pool_free(data); }
+	pool_string(const pool_string&) = delete;
+	pool_string& operator=(const pool_string&) = delete;
+
+	size_t size() const { return length; }
+
+	void reserve(size_t size) {
+		if ((data && size <= capacity) || failed) return;
+		size_t wanted = capacity * 2 > size ? capacity * 2 : size;
+		char* larger = pool_alloc(wanted + 1);
+		if (!larger) {
+			failed = true;
+			return;
+		}
+		if (length) memcpy(larger, data, length);
+		pool_free(data);
+		data = larger;
+		capacity = pool_usable_size(wanted + 1) - 1;
+	}
+
+	void append(const char* text, size_t count) {
+		reserve(length + count);
+		if (failed) return;
+		memcpy(data + length, text, count);
+		length += count;
+	}
+
+	void append(const std::string& text, size_t offset, size_t count) { append(text.data() + offset, count); }
+	pool_string& operator+=(char c) { append(&c, 1); return *this; }
+	pool_string& operator+=(const char* text) { append(text, strlen(text)); return *this; }
+	pool_string& operator+=(const std::string& text) { append(text.data(), text.size()); return *this; }
+
+	/* The terminated text, for the client to hand back through ts3plugin_freeMemory */
+	char* release() {
+		reserve(length);
+		if (failed) return NULL;
+		data[length] = '\0';
+		char* result = data;
+		data = NULL;
+		return result;
+	}
+};
+
+/* Gives all free buffers back to the heap */
+void release_buffer_pool() {
+	std::lock_guard<std::mutex> lock(buffer_pool_mutex);
+	for (unsigned int i = 0; i < POOL_CLASSES; i++) {
+		while (pool_free_lists[i]) {
+			pool_header* header = pool_free_lists[i];
+			pool_free_lists[i] = (pool_header*)header->next;
+			free(header);
+		}
+	}
+	buffer_pool_stats.retained_bytes = 0;
+}
+
+std::string buffer_pool_stats_string() {
+	std::lock_guard<std::mutex> lock(buffer_pool_mutex);
+	const pool_stats& s = buffer_pool_stats;
+	unsigned long long requests = s.reused + s.allocated + s.oversize;
+	return std::to_string(requests) + " buffers, " + std::to_string(requests ? s.reused * 100 / requests : 0) + " % reused, "
+		+ std::to_string(s.allocated) + " allocated, " + std::to_string(s.oversize) + " oversize, " + std::to_string(s.released) + " released when full, "
+		+ std::to_string(s.retained_bytes / 1024) + " KB retained (peak " + std::to_string(s.retained_peak / 1024) + " KB)";
+}
@@ -0,0 +1,326 @@
+#pragma once
+
+#include <map>
+#include <stdint.h>
+#include <memory>
+#include <mutex>
+#include <string.h>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+/*
+Recent changes of watched server, channel and client variables, per connection.
+
+The last known value of each watched variable is kept per item. An edit event compares the item's variables against
+them and adds a record for each difference to a ring of FEED_CAPACITY records. Events that only carry requested
+variables (onServerUpdatedEvent, onUpdateChannelEvent) refresh the known values without adding records.
+
+Values are cut to FEED_VALUE_BYTES and interned in the connection's string table (string_table.h). Known values and
+records only hold handles; on a large server most clients share their platform, version, country, badges, group and
+talk power values. Values of clients that left stay in the table until the connection budget trim compacts it.
+*/
+
+#define FEED_CAPACITY 256
+#define FEED_VALUE_BYTES 48
+#define FEED_MAX_FIELDS 16
+#define FEED_SHOWN 5
+
+enum feed_kind {
+	FEED_SERVER,
+	FEED_CHANNEL,
+	FEED_CLIENT,
+	FEED_KINDS
+};
+
+struct feed_field {
+	size_t flag;
+	const char* name;
+	bool requested;  /* may only be known after requestClientVariables, the first value is taken without a record */
+};
+
+static const feed_field feed_server_fields[] = {
+	{ VIRTUALSERVER_NAME, "name" },
+	{ VIRTUALSERVER_WELCOMEMESSAGE, "welcome message" },
+	{ VIRTUALSERVER_MAXCLIENTS, "max clients" },
+	{ VIRTUALSERVER_DEFAULT_SERVER_GROUP, "default server group" },
+	{ VIRTUALSERVER_DEFAULT_CHANNEL_GROUP, "default channel group" },
+	{ VIRTUALSERVER_DEFAULT_CHANNEL_ADMIN_GROUP, "default channel admin group" },
+	{ VIRTUALSERVER_ANTIFLOOD_POINTS_TICK_REDUCE, "antiflood points reduced per tick" },
+	{ VIRTUALSERVER_ANTIFLOOD_POINTS_NEEDED_COMMAND_BLOCK, "antiflood command block" },
+	{ VIRTUALSERVER_ANTIFLOOD_POINTS_NEEDED_IP_BLOCK, "antiflood ip block" },
+	{ VIRTUALSERVER_HOSTBUTTON_URL, "hostbutton link" },
+};
+
+static const feed_field feed_channel_fields[] = {
+	{ CHANNEL_NAME, "name" },
+	{ CHANNEL_TOPIC, "topic" },
+	{ CHANNEL_MAXCLIENTS, "max clients" },
+	{ CHANNEL_FLAG_PASSWORD, "password" },
+	{ CHANNEL_CODEC_QUALITY, "codec quality" },
+	{ CHANNEL_NEEDED_TALK_POWER, "needed talk power" },
+};
+
+/* Only variables every visible client has, so answers to requestClientVariables do not show up as changes */
+static const feed_field feed_client_fields[] = {
+	{ CLIENT_NICKNAME, "nickname" },
+	{ CLIENT_AWAY, "away" },
+	{ CLIENT_AWAY_MESSAGE, "away message" },
+	{ CLIENT_INPUT_MUTED, "microphone muted" },
+	{ CLIENT_OUTPUT_MUTED, "speakers muted" },
+	{ CLIENT_IS_RECORDING, "recording" },
+	{ CLIENT_SERVERGROUPS, "server groups" },
+	{ CLIENT_CHANNEL_GROUP_ID, "channel group" },
+	{ CLIENT_TALK_POWER, "talk power" },
+	{ CLIENT_PLATFORM, "platform", true },
+	{ CLIENT_VERSION, "version", true },
+	{ CLIENT_COUNTRY, "country", true },
+	{ CLIENT_BADGES, "badges", true },
+};
+
+static_assert(sizeof(feed_server_fields) / sizeof(feed_server_fields[0]) <= FEED_MAX_FIELDS, "raise FEED_MAX_FIELDS");
+static_assert(sizeof(feed_channel_fields) / sizeof(feed_channel_fields[0]) <= FEED_MAX_FIELDS, "raise FEED_MAX_FIELDS");
+static_assert(sizeof(feed_client_fields) / sizeof(feed_client_fields[0]) <= FEED_MAX_FIELDS, "raise FEED_MAX_FIELDS");
+
+static const feed_field* const feed_fields[FEED_KINDS] = { feed_server_fields, feed_channel_fields, feed_client_fields };
+static const size_t feed_field_counts[FEED_KINDS] = {
+	sizeof(feed_server_fields) / sizeof(feed_server_fields[0]),
+	sizeof(feed_channel_fields) / sizeof(feed_channel_fields[0]),
+	sizeof(feed_client_fields) / sizeof(feed_client_fields[0]),
+};
+
+/* Values as read, before they are interned */
+struct feed_text {
+	char values[FEED_MAX_FIELDS][FEED_VALUE_BYTES];
+};
+
+struct feed_values {
+	uint32_t values[FEED_MAX_FIELDS];  /* handles into change_feed::strings */
+};
+
+struct feed_record {
+	long long time;
+	uint64 item;
+	anyID invoker;
+	unsigned char kind;
+	unsigned char field;      /* index into feed_fields[kind] */
+	uint32_t old_value;       /* handles into change_feed::strings */
+	uint32_t new_value;
+	uint32_t invoker_name;
+};
+
+struct change_feed {
+	feed_record records[FEED_CAPACITY];
+	size_t total;  /* records ever added, the newest is records[(total - 1) % FEED_CAPACITY] */
+	std::unordered_map<uint64, feed_values> known[FEED_KINDS];  /* last known values per item */
+	string_table strings;
+};
+
+static std::map<uint64, std::unique_ptr<change_feed> > change_feeds;
+static std::mutex change_feeds_mutex;
+
+/* Cuts at a UTF-8 character boundary */
+static size_t feed_copy(char* target, const char* value) {
+	size_t length = strlen(value);
+	if (length >= FEED_VALUE_BYTES) {
+		length = FEED_VALUE_BYTES - 1;
+		while (length > 0 && ((unsigned char)value[length] & 0xC0) == 0x80) length--;
+	}
+	memcpy(target, value, length);
+	target[length] = '\0';
+	return length;
+}
+
+static void feed_read(uint64 serverConnectionHandlerID, int kind, uint64 item, feed_text& out) {
+	for (size_t i = 0; i < feed_field_counts[kind]; i++) {
+		size_t flag = feed_fields[kind][i].flag;
+		char* value;
+		unsigned int error;
+		if (kind == FEED_SERVER) error = ts3Functions.getServerVariableAsString(serverConnectionHandlerID, flag, &value);
+		else if (kind == FEED_CHANNEL) error = ts3Functions.getChannelVariableAsString(serverConnectionHandlerID, item, flag, &value);
+		else error = ts3Functions.getClientVariableAsString(serverConnectionHandlerID, (anyID)item, flag, &value);
+		if (error != ERROR_ok) {
+			out.values[i][0] = '\0';
+			continue;
+		}
+		feed_copy(out.values[i], value);
+		ts3Functions.freeMemory(value);
+	}
+}
+
+static change_feed& feed_of(uint64 serverConnectionHandlerID) {
+	std::unique_ptr<change_feed>& feed = change_feeds[serverConnectionHandlerID];
+	if (!feed) {
+		feed.reset(new change_feed());
+	}
+	return *feed;
+}
+
+/*
+Takes the current values of an item. With record set, every value that differs from the known one is added to the feed,
+an item seen for the first time only becomes known.
+*/
+static void feed_update(uint64 serverConnectionHandlerID, int kind, uint64 item, bool record, anyID invokerID, const char* invokerName) {
+	feed_text text;
+	feed_read(serverConnectionHandlerID, kind, item, text);
+
+	std::lock_guard<std::mutex> lock(change_feeds_mutex);
+	if (!connection_open(serverConnectionHandlerID)) return;
+	change_feed& feed = feed_of(serverConnectionHandlerID);
+	feed_values current = {};
+	for (size_t i = 0; i < feed_field_counts[kind]; i++) {
+		current.values[i] = intern_string(feed.strings, text.values[i], strlen(text.values[i]));
+	}
+	std::unordered_map<uint64, feed_values>::iterator known = feed.known[kind].find(item);
+	if (known == feed.known[kind].end()) {
+		feed.known[kind][item] = current;
+		return;
+	}
+	for (size_t i = 0; i < feed_field_counts[kind]; i++) {
+		if (known->second.values[i] == current.values[i]) continue;
+		if (record && !(feed_fields[kind][i].requested && known->second.values[i] == STRING_HANDLE_EMPTY)) {
+			feed_record& entry = feed.records[feed.total % FEED_CAPACITY];
+			char name[FEED_VALUE_BYTES];
+			entry.time = (long long)time(NULL);
+			entry.item = item;
+			entry.invoker = invokerID;
+			entry.kind = (unsigned char)kind;
+			entry.field = (unsigned char)i;
+			entry.old_value = known->second.values[i];
+			entry.new_value = current.values[i];
+			entry.invoker_name = intern_string(feed.strings, name, feed_copy(name, invokerName ? invokerName : ""));
+			feed.total++;
+		}
+		known->second.values[i] = current.values[i];
+	}
+}
+
+/* The item's values are current, e.g. after they were requested or the item became visible */
+void feed_observe(uint64 serverConnectionHandlerID, int kind, uint64 item) {
+	feed_update(serverConnectionHandlerID, kind, item, false, 0, NULL);
+}
+
+/* The item was edited, by invokerName if known */
+void feed_changed(uint64 serverConnectionHandlerID, int kind, uint64 item, anyID invokerID, const char* invokerName) {
+	feed_update(serverConnectionHandlerID, kind, item, true, invokerID, invokerName);
+}
+
+/* Everything visible right after connecting */
+void feed_observe_connection(uint64 serverConnectionHandlerID) {
+	feed_observe(serverConnectionHandlerID, FEED_SERVER, 0);
+	uint64* channels;
+	if (ts3Functions.getChannelList(serverConnectionHandlerID, &channels) == ERROR_ok) {
+		for (uint64* channel = channels; *channel; channel++) feed_observe(serverConnectionHandlerID, FEED_CHANNEL, *channel);
+		ts3Functions.freeMemory(channels);
+	}
+	anyID* clients;
+	if (ts3Functions.getClientList(serverConnectionHandlerID, &clients) == ERROR_ok) {
+		for (anyID* client = clients; *client; client++) feed_observe(serverConnectionHandlerID, FEED_CLIENT, *client);
+		ts3Functions.freeMemory(clients);
+	}
+}
+
+/* Known values only; records of the item stay until they are overwritten */
+void feed_forget(uint64 serverConnectionHandlerID, int kind, uint64 item) {
+	std::lock_guard<std::mutex> lock(change_feeds_mutex);
+	std::map<uint64, std::unique_ptr<change_feed> >::iterator it = change_feeds.find(serverConnectionHandlerID);
+	if (it != change_feeds.end()) it->second->known[kind].erase(item);
+}
+
+/* Re-interns the values still held by known items and records into a new table; values nothing refers to are dropped */
+static void feed_compact(change_feed& feed) {
+	string_table strings;
+	for (int kind = 0; kind < FEED_KINDS; kind++) {
+		for (std::unordered_map<uint64, feed_values>::iterator it = feed.known[kind].begin(); it != feed.known[kind].end(); ++it) {
+			for (size_t i = 0; i < feed_field_counts[kind]; i++) it->second.values[i] = reintern_string(strings, feed.strings, it->second.values[i]);
+		}
+	}
+	size_t available = feed.total < FEED_CAPACITY ? feed.total : FEED_CAPACITY;
+	for (size_t n = 1; n <= available; n++) {
+		feed_record& entry = feed.records[(feed.total - n) % FEED_CAPACITY];
+		entry.old_value = reintern_string(strings, feed.strings, entry.old_value);
+		entry.new_value = reintern_string(strings, feed.strings, entry.new_value);
+		entry.invoker_name = reintern_string(strings, feed.strings, entry.invoker_name);
+	}
+	feed.strings = std::move(strings);
+}
+
+/* From the connection budget trim */
+void compact_change_feed(uint64 serverConnectionHandlerID) {
+	std::lock_guard<std::mutex> lock(change_feeds_mutex);
+	std::map<uint64, std::unique_ptr<change_feed> >::iterator it = change_feeds.find(serverConnectionHandlerID);
+	if (it != change_feeds.end()) feed_compact(*it->second);
+}
+
+/* From the connection budget trim, when compacting was not enough. Known values stay, changes are still detected. */
+void drop_change_feed_records(uint64 serverConnectionHandlerID) {
+	std::lock_guard<std::mutex> lock(change_feeds_mutex);
+	std::map<uint64, std::unique_ptr<change_feed> >::iterator it = change_feeds.find(serverConnectionHandlerID);
+	if (it == change_feeds.end()) return;
+	it->second->total = 0;
+	feed_compact(*it->second);
+}
+
+void feed_forget_connection(uint64 serverConnectionHandlerID) {
+	std::lock_guard<std::mutex> lock(change_feeds_mutex);
+	change_feeds.erase(serverConnectionHandlerID);
+}
+
+/* Approximate heap use of the connection's feed */
+size_t change_feed_bytes(uint64 serverConnectionHandlerID) {
+	std::lock_guard<std::mutex> lock(change_feeds_mutex);
+	std::map<uint64, std::unique_ptr<change_feed> >::const_iterator it = change_feeds.find(serverConnectionHandlerID);
+	if (it == change_feeds.end()) return 0;
+	size_t bytes = sizeof(change_feed) + string_table_bytes(it->second->strings);
+	for (int kind = 0; kind < FEED_KINDS; kind++) {
+		bytes += it->second->known[kind].size() * (sizeof(std::pair<const uint64, feed_values>) + MAP_NODE_OVERHEAD);
+		bytes += it->second->known[kind].bucket_count() * sizeof(void*);
+	}
+	return bytes;
+}
+
+/* "812 distinct values in 40 KB, 1630 KB saved", saved against a FEED_VALUE_BYTES copy of every value held */
+std::string change_feed_strings_string(uint64 serverConnectionHandlerID) {
+	std::lock_guard<std::mutex> lock(change_feeds_mutex);
+	std::map<uint64, std::unique_ptr<change_feed> >::const_iterator it = change_feeds.find(serverConnectionHandlerID);
+	if (it == change_feeds.end()) return "no values";
+	const change_feed& feed = *it->second;
+	size_t held = 3 * (feed.total < FEED_CAPACITY ? feed.total : FEED_CAPACITY);
+	for (int kind = 0; kind < FEED_KINDS; kind++) held += feed.known[kind].size() * feed_field_counts[kind];
+	size_t copies = held * FEED_VALUE_BYTES;
+	size_t interned = held * sizeof(uint32_t) + string_table_bytes(feed.strings);
+	return std::to_string(string_table_size(feed.strings)) + " distinct values in " + std::to_string(string_table_bytes(feed.strings) / 1024) + " KB, "
+		+ std::to_string(copies > interned ? (copies - interned) / 1024 : 0) + " KB saved";
+}
+
+/* Newest first, at most FEED_SHOWN changes of the item */
+std::string change_feed_string(uint64 serverConnectionHandlerID, int kind, uint64 item) {
+	std::string result;
+	long long now = (long long)time(NULL);
+	std::lock_guard<std::mutex> lock(change_feeds_mutex);
+	std::map<uint64, std::unique_ptr<change_feed> >::const_iterator it = change_feeds.find(serverConnectionHandlerID);
+	if (it == change_feeds.end()) return "[I]none[/I]\n";
+	const change_feed& feed = *it->second;
+	size_t available = feed.total < FEED_CAPACITY ? feed.total : FEED_CAPACITY;
+	int shown = 0;
+	for (size_t n = 1; n <= available && shown < FEED_SHOWN; n++) {
+		const feed_record& entry = feed.records[(feed.total - n) % FEED_CAPACITY];
+		if (entry.kind != kind || entry.item != item) continue;
+		result += feed_fields[kind][entry.field].name;
+		const char* old_value = interned_string(feed.strings, entry.old_value);
+		const char* new_value = interned_string(feed.strings, entry.new_value);
+		result += ": [B]";
+		bbcode_escape_append(old_value, strlen(old_value), result);
+		result += "[/B] -> [B]";
+		bbcode_escape_append(new_value, strlen(new_value), result);
+		result += "[/B]";
+		if (entry.invoker_name != STRING_HANDLE_EMPTY) {
+			const char* invoker_name = interned_string(feed.strings, entry.invoker_name);
+			result += " by ";
+			bbcode_escape_append(invoker_name, strlen(invoker_name), result);
+		}
+		result += ", " + age_string(now - entry.time) + " ago\n";
+		shown++;
+	}
+	return shown ? result : "[I]none[/I]\n";
+}
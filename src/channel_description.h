@@ -0,0 +1,132 @@
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+
+/*
+Channel descriptions need their own round trip, so they are only requested the first time a channel is shown.
+Each description is stored once together with its hash; an update carrying the same text changes nothing.
+*/
+
+#define DEFAULT_DESCRIPTION_MAX_LENGTH 1024
+
+static std::atomic<size_t> description_max_length(DEFAULT_DESCRIPTION_MAX_LENGTH);  /* set from the settings */
+
+struct channel_description {
+	bool received;
+	unsigned long long hash;
+	size_t full_length;
+	std::string text;  /* truncated to description_max_length, then escaped */
+};
+
+static std::map<std::pair<uint64, uint64>, channel_description> channel_descriptions;
+static std::mutex channel_descriptions_mutex;
+
+/* Cuts at a UTF-8 character boundary and never inside a BBCode tag */
+static std::string truncate_description(const char* description, size_t length, size_t max_length) {
+	if (length <= max_length) return std::string(description, length);
+	size_t cut = max_length;
+	while (cut > 0 && ((unsigned char)description[cut] & 0xC0) == 0x80) cut--;
+	for (size_t i = cut; i > 0; i--) {
+		if (description[i - 1] == ']') break;
+		if (description[i - 1] == '[') {
+			cut = i - 1;
+			break;
+		}
+	}
+	return std::string(description, cut);
+}
+
+std::string channel_description_string(uint64 serverConnectionHandlerID, uint64 channelID) {
+	bool request = false;
+	std::string result;
+	{
+		std::lock_guard<std::mutex> lock(channel_descriptions_mutex);
+		std::pair<uint64, uint64> key(serverConnectionHandlerID, channelID);
+		std::map<std::pair<uint64, uint64>, channel_description>::iterator it = channel_descriptions.find(key);
+		if (it == channel_descriptions.end()) {
+			if (!connection_open(serverConnectionHandlerID)) return "[I]loading...[/I]\n";
+			channel_description& entry = channel_descriptions[key];
+			entry.received = false;
+			entry.hash = 0;
+			entry.full_length = 0;
+			request = true;
+			result = "[I]loading...[/I]\n";
+		}
+		else if (!it->second.received) {
+			result = "[I]loading...[/I]\n";
+		}
+		else if (it->second.full_length == 0) {
+			result = "[I]none[/I]\n";
+		}
+		else {
+			result = it->second.text;
+			if (it->second.text.size() < it->second.full_length) {
+				result += " [I](truncated, ";
+				result += std::to_string(it->second.full_length);
+				result += " bytes)[/I]";
+			}
+			result += "\n";
+		}
+	}
+	if (request) {
+		ts3Functions.requestChannelDescription(serverConnectionHandlerID, channelID, NULL);
+	}
+	return result;
+}
+
+/* Called once the description arrived or was edited. Only a changed hash replaces the stored text and refreshes the panel. */
+void channel_description_updated(uint64 serverConnectionHandlerID, uint64 channelID) {
+	char* description;
+	if (ts3Functions.getChannelVariableAsString(serverConnectionHandlerID, channelID, CHANNEL_DESCRIPTION, &description) != ERROR_ok) {
+		return;
+	}
+	size_t length = strlen(description);
+	unsigned long long hash = hash_string(description, length);
+	bool changed = false;
+	{
+		std::lock_guard<std::mutex> lock(channel_descriptions_mutex);
+		/* An answer after the disconnect */
+		channel_description* entry = connection_open(serverConnectionHandlerID) ? &channel_descriptions[std::make_pair(serverConnectionHandlerID, channelID)] : NULL;
+		if (entry && (!entry->received || entry->hash != hash)) {
+			entry->received = true;
+			entry->hash = hash;
+			entry->full_length = length;
+			entry->text = bbcode_escape(truncate_description(description, length, description_max_length.load()));
+			changed = true;
+		}
+	}
+	ts3Functions.freeMemory(description);
+	if (changed) {
+		ts3Functions.requestInfoUpdate(serverConnectionHandlerID, PLUGIN_CHANNEL, channelID);
+	}
+}
+
+void forget_channel_description(uint64 serverConnectionHandlerID, uint64 channelID) {
+	std::lock_guard<std::mutex> lock(channel_descriptions_mutex);
+	channel_descriptions.erase(std::make_pair(serverConnectionHandlerID, channelID));
+}
+
+/* All of the connection's descriptions but keepChannelID's; dropped ones are requested again when shown */
+void forget_channel_descriptions(uint64 serverConnectionHandlerID, uint64 keepChannelID) {
+	std::lock_guard<std::mutex> lock(channel_descriptions_mutex);
+	std::map<std::pair<uint64, uint64>, channel_description>::iterator it = channel_descriptions.lower_bound(std::make_pair(serverConnectionHandlerID, (uint64)0));
+	while (it != channel_descriptions.end() && it->first.first == serverConnectionHandlerID) {
+		if (it->first.second == keepChannelID) ++it;
+		else it = channel_descriptions.erase(it);
+	}
+}
+
+/* Approximate heap use of the connection's descriptions */
+size_t channel_descriptions_bytes(uint64 serverConnectionHandlerID) {
+	size_t bytes = 0;
+	std::lock_guard<std::mutex> lock(channel_descriptions_mutex);
+	std::map<std::pair<uint64, uint64>, channel_description>::const_iterator it = channel_descriptions.lower_bound(std::make_pair(serverConnectionHandlerID, (uint64)0));
+	for (; it != channel_descriptions.end() && it->first.first == serverConnectionHandlerID; ++it) {
+		bytes += sizeof(*it) + MAP_NODE_OVERHEAD + it->second.text.capacity();
+	}
+	return bytes;
+}
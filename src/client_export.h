@@ -0,0 +1,301 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <stdio.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "utf8_file.h"
+
+/*
+/kmi export [json|csv]: writes every client of the current server with the client variables and history to a file in
+the config directory. Cells hold the raw values, not the panel's BBCode.
+
+Runs on its own thread. Client variables are requested EXPORT_BATCH_SIZE clients at a time, at most one batch per
+EXPORT_BATCH_INTERVAL_MS; a batch is written once all of its clients were updated or EXPORT_BATCH_TIMEOUT_MS passed.
+Rows go straight to the file, so memory does not grow with the server. Clients that left since the export started
+are skipped and counted. Progress is queued and printed from the next client update event, never from the export thread.
+*/
+
+#define EXPORT_BATCH_SIZE 10
+#define EXPORT_BATCH_INTERVAL_MS 1000
+#define EXPORT_BATCH_TIMEOUT_MS 3000
+#define EXPORT_PROGRESS_INTERVAL_MS 5000
+
+struct export_job {
+	uint64 connection;
+	bool json;
+	std::string path;
+	FILE* file;
+	std::vector<anyID> ids;
+};
+
+static std::thread export_thread;
+static std::atomic<bool> export_running(false);
+static std::atomic<bool> export_cancel(false);
+static std::set<anyID> export_waiting;  /* clients of the current batch not updated yet */
+static uint64 export_connection = 0;
+static std::vector<std::pair<uint64, std::string> > export_messages;  /* printed by export_client_updated */
+static std::mutex export_mutex;
+static std::condition_variable export_updated;
+
+/*
+Raw values: the panel's variable fields, which leave escaping to render_layout, with times as unix timestamps. Fields
+that describe the local client or read files (microphone, voice level, avatar) are not exported.
+*/
+static const layout_field export_fields[] = {
+	{ "nickname", client_field<CLIENT_NICKNAME> },
+	{ "unique_identifier", client_field<CLIENT_UNIQUE_IDENTIFIER> },
+	{ "version", client_field<CLIENT_VERSION> },
+	{ "platform", client_field<CLIENT_PLATFORM> },
+	{ "nickname_phonetic", client_field<CLIENT_NICKNAME_PHONETIC> },
+	{ "country", client_field<CLIENT_COUNTRY> },
+	{ "badges", client_field<CLIENT_BADGES> },
+	{ "input_muted", client_field<CLIENT_INPUT_MUTED> },
+	{ "output_muted", client_field<CLIENT_OUTPUT_MUTED> },
+	{ "input_hardware", client_field<CLIENT_INPUT_HARDWARE> },
+	{ "output_hardware", client_field<CLIENT_OUTPUT_HARDWARE> },
+	{ "away", client_field<CLIENT_AWAY> },
+	{ "away_message", client_field<CLIENT_AWAY_MESSAGE> },
+	{ "talk_request", client_field<CLIENT_TALK_REQUEST> },
+	{ "talk_request_msg", client_field<CLIENT_TALK_REQUEST_MSG> },
+	{ "idle_time", client_field<CLIENT_IDLE_TIME> },
+	{ "is_muted", client_field<CLIENT_IS_MUTED> },
+	{ "is_recording", client_field<CLIENT_IS_RECORDING> },
+	{ "database_id", client_field<CLIENT_DATABASE_ID> },
+	{ "total_connections", client_field<CLIENT_TOTALCONNECTIONS> },
+	{ "created", client_field<CLIENT_CREATED> },
+	{ "servergroups", client_field<CLIENT_SERVERGROUPS> },
+	{ "channel_group_id", client_field<CLIENT_CHANNEL_GROUP_ID> },
+	{ "talk_power", client_field<CLIENT_TALK_POWER> },
+	{ "channel_needed_talk_power", client_channel_needed_tp_field },
+	{ "flag_avatar", client_field<CLIENT_FLAG_AVATAR> },
+	{ "icon_id", client_field<CLIENT_ICON_ID> },
+	{ "is_talker", client_field<CLIENT_IS_TALKER> },
+	{ "is_priority_speaker", client_field<CLIENT_IS_PRIORITY_SPEAKER> },
+	{ "unread_messages", client_field<CLIENT_UNREAD_MESSAGES> },
+	{ "is_channel_commander", client_field<CLIENT_IS_CHANNEL_COMMANDER> },
+	{ "description", client_field<CLIENT_DESCRIPTION> },
+};
+
+/* From this plugin's history, looked up once per row by unique identifier */
+static const char* export_history_fields[] = { "first_seen", "previous_visit", "visits", "previous_nicknames" };
+
+static void export_history_values(const std::string& uid, std::string values[4]) {
+	client_history history;
+	if (!find_client_history(uid, history)) return;
+	values[0] = std::to_string(history.first_seen);
+	values[1] = history.previous_visit ? std::to_string(history.previous_visit) : "";
+	values[2] = std::to_string(history.visits);
+	for (size_t i = 1; i < history.nicknames.size(); i++) {
+		if (i > 1) values[3] += " | ";
+		values[3] += history.nicknames[i];
+	}
+}
+
+/* Any thread. The message shows in the tab of the exported server. */
+static void export_message(uint64 connection, const std::string& message) {
+	std::lock_guard<std::mutex> lock(export_mutex);
+	export_messages.push_back(std::make_pair(connection, "Keyinator's More Info: export " + message));
+}
+
+static std::string csv_escape(const std::string& value) {
+	std::string result = "\"";
+	for (size_t i = 0; i < value.size(); i++) {
+		if (value[i] == '"') result += '"';
+		result += value[i];
+	}
+	return result + "\"";
+}
+
+static std::string json_escape(const std::string& value) {
+	std::string result = "\"";
+	for (size_t i = 0; i < value.size(); i++) {
+		unsigned char c = (unsigned char)value[i];
+		if (c == '"' || c == '\\') {
+			result += '\\';
+			result += (char)c;
+		}
+		else if (c == '\n') result += "\\n";
+		else if (c == '\r') result += "\\r";
+		else if (c == '\t') result += "\\t";
+		else if (c < 0x20) {
+			char buffer[8];
+			snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+			result += buffer;
+		}
+		else result += (char)c;
+	}
+	return result + "\"";
+}
+
+static void export_cell(const export_job& job, const char* name, const std::string& value, std::string& row) {
+	if (job.json) row += ", " + json_escape(name) + ": " + json_escape(value);
+	else row += "," + csv_escape(value);
+}
+
+/* Returns false if the client is gone */
+static bool export_row(const export_job& job, anyID clientID, bool first) {
+	std::string uid;
+	if (!client_value(job.connection, clientID, CLIENT_UNIQUE_IDENTIFIER, uid)) return false;
+
+	std::string row = job.json ? (first ? "\t{" : ",\n\t{") : "";
+	row += job.json ? "\"client_id\": " + std::to_string(clientID) : std::to_string(clientID);
+	std::string value;
+	for (size_t i = 0; i < sizeof(export_fields) / sizeof(export_fields[0]); i++) {
+		export_fields[i].fetch(job.connection, clientID, value);
+		export_cell(job, export_fields[i].name, value, row);
+	}
+	std::string history[4];
+	export_history_values(uid, history);
+	for (size_t i = 0; i < 4; i++) export_cell(job, export_history_fields[i], history[i], row);
+	row += job.json ? "}" : "\n";
+	fwrite(row.data(), 1, row.size(), job.file);
+	return true;
+}
+
+static void export_worker(export_job job) {
+	typedef std::chrono::steady_clock clock;
+	clock::time_point started = clock::now();
+	clock::time_point last_progress = started;
+	size_t written = 0;
+	size_t left = 0;
+	const std::vector<anyID>& ids = job.ids;
+
+	std::string header = job.json ? "[\n" : "client_id";
+	if (!job.json) {
+		for (size_t i = 0; i < sizeof(export_fields) / sizeof(export_fields[0]); i++) header += std::string(",") + export_fields[i].name;
+		for (size_t i = 0; i < 4; i++) header += std::string(",") + export_history_fields[i];
+		header += "\n";
+	}
+	fwrite(header.data(), 1, header.size(), job.file);
+
+	for (size_t begin = 0; begin < ids.size() && !export_cancel.load(); begin += EXPORT_BATCH_SIZE) {
+		size_t end = begin + EXPORT_BATCH_SIZE < ids.size() ? begin + EXPORT_BATCH_SIZE : ids.size();
+		clock::time_point batch_started = clock::now();
+		{
+			std::lock_guard<std::mutex> lock(export_mutex);
+			export_waiting.clear();
+			export_waiting.insert(ids.begin() + begin, ids.begin() + end);
+		}
+		for (size_t i = begin; i < end; i++) {
+			ts3Functions.requestClientVariables(job.connection, ids[i], NULL);
+		}
+		{
+			std::unique_lock<std::mutex> lock(export_mutex);
+			export_updated.wait_for(lock, std::chrono::milliseconds(EXPORT_BATCH_TIMEOUT_MS), [] { return export_waiting.empty() || export_cancel.load(); });
+			export_waiting.clear();
+		}
+		for (size_t i = begin; i < end; i++) {
+			if (export_row(job, ids[i], written == 0)) written++;
+			else left++;
+		}
+		fflush(job.file);
+
+		clock::time_point now = clock::now();
+		double seconds = std::chrono::duration<double>(now - started).count();
+		if (now - last_progress >= std::chrono::milliseconds(EXPORT_PROGRESS_INTERVAL_MS) && end < ids.size()) {
+			char buffer[128];
+			snprintf(buffer, sizeof(buffer), "%u / %u clients, %.1f clients/s", (unsigned int)end, (unsigned int)ids.size(), seconds > 0 ? end / seconds : 0.0);
+			export_message(job.connection, buffer);
+			last_progress = now;
+		}
+		/* Rate limit towards the server */
+		std::unique_lock<std::mutex> lock(export_mutex);
+		export_updated.wait_until(lock, batch_started + std::chrono::milliseconds(EXPORT_BATCH_INTERVAL_MS), [] { return export_cancel.load(); });
+	}
+
+	if (job.json) fputs(written ? "\n]\n" : "]\n", job.file);
+	long bytes = ftell(job.file);
+	fclose(job.file);
+
+	double seconds = std::chrono::duration<double>(clock::now() - started).count();
+	char buffer[128];
+	snprintf(buffer, sizeof(buffer), "%s: %u clients, %u left during export, %.1f sec, %.1f clients/s, %ld bytes", export_cancel.load() ? "cancelled" : "done",
+		(unsigned int)written, (unsigned int)left, seconds, seconds > 0 ? written / seconds : 0.0, bytes);
+	export_message(job.connection, std::string(buffer) + "\n" + job.path);
+	{
+		std::lock_guard<std::mutex> lock(export_mutex);
+		export_connection = 0;
+	}
+	/* The summary is printed by the update event of our own client */
+	anyID own_id;
+	if (ts3Functions.getClientID(job.connection, &own_id) == ERROR_ok) ts3Functions.requestClientVariables(job.connection, own_id, NULL);
+	export_running.store(false);
+}
+
+/* Returns an error message, empty once the export thread runs */
+std::string start_client_export(uint64 serverConnectionHandlerID, bool json) {
+	if (export_running.exchange(true)) return "an export is already running";
+	if (export_thread.joinable()) export_thread.join();
+
+	char stamp[32];
+	struct tm now;
+	local_time(time(NULL), now);
+	strftime(stamp, sizeof(stamp), "%Y%m%d_%H%M%S", &now);
+	export_job job;
+	job.connection = serverConnectionHandlerID;
+	job.json = json;
+	job.path = config_file_path(("KeyinatorsMoreInfo_export_" + std::string(stamp) + (json ? ".json" : ".csv")).c_str());
+
+	anyID* clients;
+	if (ts3Functions.getClientList(serverConnectionHandlerID, &clients) != ERROR_ok) {
+		export_running.store(false);
+		return "export failed, could not get the client list";
+	}
+	for (anyID* client = clients; *client; client++) job.ids.push_back(*client);
+	ts3Functions.freeMemory(clients);
+	job.file = utf8_fopen(job.path, "wb");
+	if (!job.file) {
+		export_running.store(false);
+		return "export failed, could not write " + job.path;
+	}
+
+	export_cancel.store(false);
+	{
+		std::lock_guard<std::mutex> lock(export_mutex);
+		export_connection = serverConnectionHandlerID;
+	}
+	export_thread = std::thread(export_worker, job);
+	return "";
+}
+
+/* The export thread finishes the current batch and closes the file. Only shutdown waits for that. */
+void cancel_client_export(bool wait) {
+	{
+		std::lock_guard<std::mutex> lock(export_mutex);
+		export_cancel.store(true);
+	}
+	export_updated.notify_all();
+	if (wait && export_thread.joinable()) export_thread.join();
+}
+
+/* From onUpdateClientEvent, the answer to requestClientVariables. Also prints the queued export messages. */
+void export_client_updated(uint64 serverConnectionHandlerID, anyID clientID) {
+	bool batch_done = false;
+	std::vector<std::pair<uint64, std::string> > messages;
+	{
+		std::lock_guard<std::mutex> lock(export_mutex);
+		messages.swap(export_messages);
+		if (serverConnectionHandlerID == export_connection && export_waiting.erase(clientID) != 0) batch_done = export_waiting.empty();
+	}
+	if (batch_done) export_updated.notify_all();
+	for (size_t i = 0; i < messages.size(); i++) {
+		ts3Functions.printMessage(messages[i].first, messages[i].second.c_str(), PLUGIN_MESSAGE_TARGET_SERVER);
+	}
+}
+
+/* The connection of a running export went away */
+void stop_client_export(uint64 serverConnectionHandlerID) {
+	bool ours;
+	{
+		std::lock_guard<std::mutex> lock(export_mutex);
+		ours = export_connection == serverConnectionHandlerID;
+	}
+	if (ours) cancel_client_export(false);
+}
@@ -0,0 +1,304 @@
+#pragma once
+
+#include <condition_variable>
+#include <mutex>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "utf8_file.h"
+
+/*
+Every client seen by this user, across sessions and servers, keyed by unique identifier.
+
+Sightings are appended to a tab separated log in the config directory:
+	S <time> <uid> <nickname>                                          one sighting
+	C <first> <previous visit> <last> <visits> <uid> <nicknames...>    compacted history of a client
+The whole log is replayed into a hash index on start. A background thread owns the log: the event thread only queues
+sightings, the thread appends them, updates the index and rewrites the log as C lines once it grew too long.
+*/
+
+#define HISTORY_FILENAME "KeyinatorsMoreInfo_sightings.log"
+#define HISTORY_VISIT_GAP 600  /* seconds between sightings that start a new visit */
+#define HISTORY_MAX_NICKNAMES 5
+#define HISTORY_MAX_QUEUED 10000
+#define HISTORY_COMPACT_MIN_LINES 10000
+#define HISTORY_COMPACT_RATIO 4  /* log lines per known client that trigger a compaction */
+
+struct client_history {
+	long long first_seen;
+	long long previous_visit;  /* last sighting of the visit before the current one, 0 if none */
+	long long last_seen;
+	unsigned int visits;
+	std::vector<std::string> nicknames;  /* most recent first */
+};
+
+struct client_sighting {
+	long long time;
+	std::string uid;
+	std::string nickname;
+};
+
+static std::unordered_map<std::string, client_history> history_index;
+static bool history_loaded = false;
+static std::mutex history_mutex;
+
+static std::vector<client_sighting> history_queue;
+static unsigned long history_dropped = 0;
+static bool history_stop = false;
+static std::mutex history_queue_mutex;
+static std::condition_variable history_wake;
+static std::thread history_thread;
+
+static void history_apply(client_history& entry, long long time, const std::string& nickname) {
+	if (entry.visits && time < entry.last_seen) {
+		/* Clock went back, keep it out of the visit and nickname order */
+		if (time < entry.first_seen) entry.first_seen = time;
+		return;
+	}
+	if (entry.visits == 0) {
+		entry.first_seen = time;
+		entry.visits = 1;
+	}
+	else if (time - entry.last_seen >= HISTORY_VISIT_GAP) {
+		entry.previous_visit = entry.last_seen;
+		entry.visits++;
+	}
+	if (time > entry.last_seen) entry.last_seen = time;
+	if (!nickname.empty() && (entry.nicknames.empty() || entry.nicknames[0] != nickname)) {
+		for (size_t i = 0; i < entry.nicknames.size(); i++) {
+			if (entry.nicknames[i] == nickname) {
+				entry.nicknames.erase(entry.nicknames.begin() + i);
+				break;
+			}
+		}
+		entry.nicknames.insert(entry.nicknames.begin(), nickname);
+		if (entry.nicknames.size() > HISTORY_MAX_NICKNAMES) entry.nicknames.resize(HISTORY_MAX_NICKNAMES);
+	}
+}
+
+/* Tabs and line breaks would break the log format */
+static std::string history_escape(std::string value) {
+	for (size_t i = 0; i < value.size(); i++) {
+		if (value[i] == '\t' || value[i] == '\n' || value[i] == '\r') value[i] = ' ';
+	}
+	return value;
+}
+
+static void history_replay(const std::string& line, std::unordered_map<std::string, client_history>& index) {
+	std::vector<std::string> fields = split(line, '\t');
+	if (fields.size() >= 3 && fields[0] == "S") {
+		history_apply(index[fields[2]], atoll(fields[1].c_str()), fields.size() > 3 ? fields[3] : "");
+	}
+	else if (fields.size() >= 6 && fields[0] == "C") {
+		client_history& entry = index[fields[5]];
+		entry.first_seen = atoll(fields[1].c_str());
+		entry.previous_visit = atoll(fields[2].c_str());
+		entry.last_seen = atoll(fields[3].c_str());
+		entry.visits = (unsigned int)strtoul(fields[4].c_str(), NULL, 10);
+		entry.nicknames.assign(fields.begin() + 6, fields.end());
+	}
+}
+
+static std::string history_compacted(const std::string& uid, const client_history& entry) {
+	std::string line = "C\t" + std::to_string(entry.first_seen) + "\t" + std::to_string(entry.previous_visit) + "\t" + std::to_string(entry.last_seen) + "\t" + std::to_string(entry.visits) + "\t" + uid;
+	for (size_t i = 0; i < entry.nicknames.size(); i++) {
+		line += "\t" + entry.nicknames[i];
+	}
+	return line + "\n";
+}
+
+/*
+Rewrites the log as one C line per client. Returns the new line count.
+Runs on the history thread, the only one changing the index, so the entries stay put while the lock is released and
+lookups from infoData only wait for the pointers to be collected.
+*/
+static size_t history_compact(const std::string& path) {
+	std::vector<const std::pair<const std::string, client_history>*> entries;
+	{
+		std::lock_guard<std::mutex> lock(history_mutex);
+		entries.reserve(history_index.size());
+		for (std::unordered_map<std::string, client_history>::const_iterator it = history_index.begin(); it != history_index.end(); it++) {
+			entries.push_back(&*it);
+		}
+	}
+	std::string content;
+	for (size_t i = 0; i < entries.size(); i++) {
+		content += history_compacted(entries[i]->first, entries[i]->second);
+	}
+	size_t lines = entries.size();
+	std::string temporary = path + ".tmp";
+	if (!write_file(temporary, content) || !utf8_replace_file(temporary, path)) {
+		printf("PLUGIN: could not compact %s\n", path.c_str());
+		utf8_remove(temporary);
+		return 0;
+	}
+	return lines;
+}
+
+static void history_worker() {
+	std::string path = config_file_path(HISTORY_FILENAME);
+	std::string content;
+	size_t log_lines = 0;
+	{
+		std::unordered_map<std::string, client_history> index;
+		if (read_file(path, content)) {
+			std::vector<std::string> lines = split(content, '\n');
+			for (size_t i = 0; i < lines.size(); i++) {
+				history_replay(lines[i], index);
+			}
+			log_lines = lines.size();
+		}
+		std::lock_guard<std::mutex> lock(history_mutex);
+		history_index.swap(index);
+		history_loaded = true;
+	}
+
+	FILE* log = utf8_fopen(path, "ab");
+	if (log && !content.empty() && content[content.size() - 1] != '\n') {
+		fputc('\n', log);  /* a torn last line from a crash stays on its own */
+	}
+	std::vector<client_sighting> batch;
+	while (true) {
+		bool stop;
+		{
+			std::unique_lock<std::mutex> lock(history_queue_mutex);
+			history_wake.wait(lock, [] { return history_stop || !history_queue.empty(); });
+			batch.swap(history_queue);
+			stop = history_stop;
+		}
+		if (!batch.empty()) {
+			{
+				std::lock_guard<std::mutex> lock(history_mutex);
+				for (size_t i = 0; i < batch.size(); i++) {
+					history_apply(history_index[batch[i].uid], batch[i].time, batch[i].nickname);
+				}
+			}
+			if (log) {
+				for (size_t i = 0; i < batch.size(); i++) {
+					fprintf(log, "S\t%lld\t%s\t%s\n", batch[i].time, batch[i].uid.c_str(), batch[i].nickname.c_str());
+				}
+				fflush(log);
+			}
+			log_lines += batch.size();
+			batch.clear();
+
+			size_t clients;
+			{
+				std::lock_guard<std::mutex> lock(history_mutex);
+				clients = history_index.size();
+			}
+			if (log && log_lines >= HISTORY_COMPACT_MIN_LINES && log_lines >= clients * HISTORY_COMPACT_RATIO) {
+				fclose(log);
+				size_t compacted = history_compact(path);
+				if (compacted) log_lines = compacted;
+				log = utf8_fopen(path, "ab");
+			}
+		}
+		if (stop) break;
+	}
+	if (log) fclose(log);
+}
+
+void start_client_history() {
+	if (history_thread.joinable()) return;
+	history_stop = false;
+	history_thread = std::thread(history_worker);
+}
+
+/* Writes what is still queued before returning */
+void stop_client_history() {
+	if (!history_thread.joinable()) return;
+	{
+		std::lock_guard<std::mutex> lock(history_queue_mutex);
+		history_stop = true;
+	}
+	history_wake.notify_one();
+	history_thread.join();
+}
+
+static std::string history_client_variable(uint64 serverConnectionHandlerID, anyID clientID, size_t flag) {
+	char* value;
+	if (ts3Functions.getClientVariableAsString(serverConnectionHandlerID, clientID, flag, &value) != ERROR_ok) return "";
+	std::string result = value;
+	ts3Functions.freeMemory(value);
+	return result;
+}
+
+/* Called on the event thread, only queues */
+void record_client_sighting(uint64 serverConnectionHandlerID, anyID clientID) {
+	client_sighting sighting;
+	sighting.time = (long long)time(NULL);
+	sighting.uid = history_escape(history_client_variable(serverConnectionHandlerID, clientID, CLIENT_UNIQUE_IDENTIFIER));
+	if (sighting.uid.empty()) return;
+	sighting.nickname = history_escape(history_client_variable(serverConnectionHandlerID, clientID, CLIENT_NICKNAME));
+	{
+		std::lock_guard<std::mutex> lock(history_queue_mutex);
+		if (history_queue.size() >= HISTORY_MAX_QUEUED) {
+			history_dropped++;
+			return;
+		}
+		history_queue.push_back(sighting);
+	}
+	history_wake.notify_one();
+}
+
+/* Everyone already visible when the connection is established, no move event is sent for them */
+void record_visible_clients(uint64 serverConnectionHandlerID) {
+	anyID* clients;
+	if (ts3Functions.getClientList(serverConnectionHandlerID, &clients) != ERROR_ok) return;
+	for (anyID* client = clients; *client; client++) {
+		record_client_sighting(serverConnectionHandlerID, *client);
+	}
+	ts3Functions.freeMemory(clients);
+}
+
+std::string client_history_string(uint64 serverConnectionHandlerID, anyID clientID) {
+	std::string uid = history_escape(history_client_variable(serverConnectionHandlerID, clientID, CLIENT_UNIQUE_IDENTIFIER));
+	client_history entry;
+	{
+		std::lock_guard<std::mutex> lock(history_mutex);
+		if (!history_loaded) return "[I]loading...[/I]\n";
+		std::unordered_map<std::string, client_history>::const_iterator it = history_index.find(uid);
+		if (it == history_index.end()) return "[I]first sighting[/I]\n";
+		entry = it->second;
+	}
+	std::string result = "first seen: [B]" + get_time_string((int)entry.first_seen) + "[/B]\n";
+	result += "last visit: [B]";
+	result += entry.previous_visit ? age_string((long long)time(NULL) - entry.previous_visit) + " ago" : "none";
+	result += "[/B]\n";
+	result += "visits: [B]" + std::to_string(entry.visits) + "[/B]\n";
+	if (entry.nicknames.size() > 1) {
+		result += "previous nicknames: ";
+		for (size_t i = 1; i < entry.nicknames.size(); i++) {
+			result += i > 1 ? " | [B]" : "[B]";
+			bbcode_escape_append(entry.nicknames[i].data(), entry.nicknames[i].size(), result);
+			result += "[/B]";
+		}
+		result += "\n";
+	}
+	return result;
+}
+
+/* False if the client is unknown or the history is still loading */
+bool find_client_history(const std::string& uid, client_history& out) {
+	std::lock_guard<std::mutex> lock(history_mutex);
+	std::unordered_map<std::string, client_history>::const_iterator it = history_index.find(uid);
+	if (it == history_index.end()) return false;
+	out = it->second;
+	return true;
+}
+
+std::string client_history_stats_string() {
+	size_t clients;
+	{
+		std::lock_guard<std::mutex> lock(history_mutex);
+		clients = history_index.size();
+	}
+	std::lock_guard<std::mutex> lock(history_queue_mutex);
+	return std::to_string(clients) + " clients known, " + std::to_string(history_dropped) + " sightings dropped";
+}
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <ctime>
+#include <map>
+#include <mutex>
+#include <string>
+
+/*
+What the plugin holds for one server tab. The state is opened when the connection is established and closed on
+disconnect or server stop; closing drops everything the feature modules keep for the connection, so reconnects and
+server switches leave nothing behind (shared history, voice meters and microphone diagnostics included). Modules
+create nothing for a connection that is not open (open_connections.h). Client history and server snapshots outlive
+connections on purpose.
+
+A connection may hold up to connection_budget_kb (settings). Usage is measured at most every CONNECTION_CHECK_SECONDS
+while its panels render and while edits and clients coming into view add to its change feed, so a background tab is
+bounded as well. Over budget, the change feed's string table is compacted first, which loses nothing. Then the
+caches that can be rebuilt are trimmed: finished file summaries, then the descriptions of channels not shown right
+now. Both are fetched again when needed. Last, the change feed drops its records; known values stay.
+*/
+
+#define CONNECTION_CHECK_SECONDS 5
+
+struct connection_usage {
+	size_t feed;
+	size_t descriptions;
+	size_t files;
+	size_t shared;
+
+	size_t total() const { return feed + descriptions + files + shared; }
+};
+
+struct connection_state {
+	time_t established;
+	time_t last_check;
+	uint64 shown_channel;    /* of the last panel rendered, 0 if it was no channel */
+	connection_usage usage;  /* at the last check */
+	unsigned long trims;
+};
+
+static std::map<uint64, connection_state> connection_states;
+static std::mutex connection_states_mutex;
+
+static connection_usage measure_connection(uint64 serverConnectionHandlerID) {
+	connection_usage usage;
+	usage.feed = change_feed_bytes(serverConnectionHandlerID);
+	usage.descriptions = channel_descriptions_bytes(serverConnectionHandlerID);
+	usage.files = channel_storages_bytes(serverConnectionHandlerID);
+	usage.shared = shared_history_bytes(serverConnectionHandlerID);
+	return usage;
+}
+
+void open_connection_state(uint64 serverConnectionHandlerID) {
+	std::lock_guard<std::mutex> lock(connection_states_mutex);
+	connection_state& state = connection_states[serverConnectionHandlerID];
+	state = connection_state();
+	state.established = time(NULL);
+	set_connection_open(serverConnectionHandlerID, true);
+}
+
+/* The plugin was loaded while connected */
+void open_established_connections() {
+	uint64* connections;
+	if (ts3Functions.getServerConnectionHandlerList(&connections) != ERROR_ok) return;
+	for (uint64* connection = connections; *connection; connection++) {
+		int status;
+		if (ts3Functions.getConnectionStatus(*connection, &status) == ERROR_ok && status == STATUS_CONNECTION_ESTABLISHED) {
+			open_connection_state(*connection);
+		}
+	}
+	ts3Functions.freeMemory(connections);
+}
+
+/* Safe to call more than once, a server stop is followed by a disconnect */
+void close_connection_state(uint64 serverConnectionHandlerID) {
+	set_connection_open(serverConnectionHandlerID, false);  /* first, so nothing is created again while dropping */
+	set_server_info_live(serverConnectionHandlerID, false);
+	stop_client_export(serverConnectionHandlerID);
+	flush_server_snapshots();
+	feed_forget_connection(serverConnectionHandlerID);
+	forget_channel_descriptions(serverConnectionHandlerID, 0);
+	forget_channel_storages(serverConnectionHandlerID);
+	forget_shared_history(serverConnectionHandlerID);
+	release_connection_meters(serverConnectionHandlerID);
+	reset_mic_diagnostics(serverConnectionHandlerID);
+
+	std::lock_guard<std::mutex> lock(connection_states_mutex);
+	connection_states.erase(serverConnectionHandlerID);
+}
+
+/* From infoData and the events that add to the change feed. The shown channel's description is kept, trimming it would only fetch it again. */
+void check_connection_budget(uint64 serverConnectionHandlerID) {
+	time_t now = time(NULL);
+	uint64 shownChannelID;
+	{
+		std::lock_guard<std::mutex> lock(connection_states_mutex);
+		std::map<uint64, connection_state>::iterator it = connection_states.find(serverConnectionHandlerID);
+		if (it == connection_states.end() || now - it->second.last_check < CONNECTION_CHECK_SECONDS) return;
+		it->second.last_check = now;
+		shownChannelID = it->second.shown_channel;
+	}
+
+	size_t budget = connection_budget_kb.load() * 1024;
+	connection_usage usage = measure_connection(serverConnectionHandlerID);
+	bool trimmed = false;
+	if (usage.total() > budget && usage.feed) {
+		compact_change_feed(serverConnectionHandlerID);
+		usage.feed = change_feed_bytes(serverConnectionHandlerID);
+		trimmed = true;
+	}
+	if (usage.total() > budget && usage.files) {
+		invalidate_channel_storage(serverConnectionHandlerID);
+		usage.files = channel_storages_bytes(serverConnectionHandlerID);
+		trimmed = true;
+	}
+	if (usage.total() > budget && usage.descriptions) {
+		forget_channel_descriptions(serverConnectionHandlerID, shownChannelID);
+		usage.descriptions = channel_descriptions_bytes(serverConnectionHandlerID);
+		trimmed = true;
+	}
+	if (usage.total() > budget && usage.feed) {
+		drop_change_feed_records(serverConnectionHandlerID);
+		usage.feed = change_feed_bytes(serverConnectionHandlerID);
+		trimmed = true;
+	}
+
+	std::lock_guard<std::mutex> lock(connection_states_mutex);
+	std::map<uint64, connection_state>::iterator it = connection_states.find(serverConnectionHandlerID);
+	if (it == connection_states.end()) return;  /* closed meanwhile */
+	it->second.usage = usage;
+	if (trimmed) it->second.trims++;
+}
+
+/* Called when a panel of the connection renders, before checking the budget */
+void connection_panel_shown(uint64 serverConnectionHandlerID, uint64 shownChannelID) {
+	std::lock_guard<std::mutex> lock(connection_states_mutex);
+	std::map<uint64, connection_state>::iterator it = connection_states.find(serverConnectionHandlerID);
+	if (it != connection_states.end()) it->second.shown_channel = shownChannelID;
+}
+
+/* One line per open connection, measured now */
+std::string connection_stats_string() {
+	std::map<uint64, connection_state> states;
+	{
+		std::lock_guard<std::mutex> lock(connection_states_mutex);
+		states = connection_states;
+	}
+	if (states.empty()) return "connections: none\n";
+	std::string result;
+	size_t budget = connection_budget_kb.load();
+	time_t now = time(NULL);
+	for (std::map<uint64, connection_state>::const_iterator it = states.begin(); it != states.end(); it++) {
+		connection_usage usage = measure_connection(it->first);
+		result += "connection " + std::to_string(it->first) + ": " + std::to_string(usage.total() / 1024) + " of " + std::to_string(budget) + " KB";
+		result += " (changes " + std::to_string(usage.feed / 1024) + " KB, descriptions " + std::to_string(usage.descriptions / 1024) + " KB, files " + std::to_string(usage.files / 1024) + " KB, shared history " + std::to_string(usage.shared / 1024) + " KB)";
+		result += ", connected " + age_string((long long)(now - it->second.established)) + ", trimmed " + std::to_string(it->second.trims) + " times\n";
+		result += "  interned: " + change_feed_strings_string(it->first) + "\n";
+	}
+	return result;
+}
@@ -0,0 +1,264 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+/*
+Wire format of the history exchange (info_exchange.h). Encoding and decoding only: no SDK calls and no state, so it is
+tested on its own (test/exchange_codec_test.cpp).
+
+Messages are binary, base64 encoded behind EXCHANGE_PREFIX and never longer than EXCHANGE_MAX_COMMAND_BYTES:
+	version, type, varint sender client ID, then
+	request:  varint count, count client IDs
+	answer:   varint base time, varint count, count times
+	          client ID, varint base - first seen, varint base - previous visit + 1 (0 if none), varint visits
+Client IDs are varints of the difference to the previous one, modulo 65536. Sent in ascending order, nearly every
+difference takes one byte. Whatever does not fit is left for the next message.
+*/
+
+#define EXCHANGE_VERSION 1
+#define EXCHANGE_PREFIX "kmi:"
+#define EXCHANGE_MAX_COMMAND_BYTES 1024
+#define EXCHANGE_MAX_MESSAGE_BYTES ((EXCHANGE_MAX_COMMAND_BYTES - (sizeof(EXCHANGE_PREFIX) - 1)) / 4 * 3)
+#define EXCHANGE_LOOPBACK_SENDER 0xFFFF  /* client IDs never reach it */
+
+enum exchange_type {
+	EXCHANGE_REQUEST = 1,
+	EXCHANGE_ANSWER = 2
+};
+
+struct exchange_entry {
+	anyID client;
+	long long first_seen;
+	long long previous_visit;  /* 0 if none */
+	unsigned int visits;
+};
+
+struct exchange_message {
+	int type;
+	anyID sender;
+	long long base;                       /* answers: the sender's time */
+	std::vector<anyID> clients;           /* requests */
+	std::vector<exchange_entry> entries;  /* answers */
+};
+
+static const char exchange_base64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static std::string base64_encode(const std::string& data) {
+	std::string result;
+	result.reserve((data.size() + 2) / 3 * 4);
+	for (size_t i = 0; i < data.size(); i += 3) {
+		unsigned int bits = (unsigned char)data[i] << 16;
+		if (i + 1 < data.size()) bits |= (unsigned char)data[i + 1] << 8;
+		if (i + 2 < data.size()) bits |= (unsigned char)data[i + 2];
+		result += exchange_base64[(bits >> 18) & 63];
+		result += exchange_base64[(bits >> 12) & 63];
+		result += i + 1 < data.size() ? exchange_base64[(bits >> 6) & 63] : '=';
+		result += i + 2 < data.size() ? exchange_base64[bits & 63] : '=';
+	}
+	return result;
+}
+
+static bool base64_decode(const char* text, std::string& out) {
+	out.clear();
+	unsigned int bits = 0;
+	int count = 0;
+	for (; *text && *text != '='; text++) {
+		const char* digit = strchr(exchange_base64, *text);
+		if (!digit) return false;
+		bits = (bits << 6) | (unsigned int)(digit - exchange_base64);
+		if (++count == 4) {
+			out += (char)(bits >> 16);
+			out += (char)(bits >> 8);
+			out += (char)bits;
+			bits = 0;
+			count = 0;
+		}
+	}
+	if (count == 1) return false;
+	if (count >= 2) out += (char)(bits >> (count == 2 ? 4 : 10));
+	if (count == 3) out += (char)(bits >> 2);
+	return true;
+}
+
+static void put_varint(std::string& out, unsigned long long value) {
+	while (value >= 0x80) {
+		out += (char)(value | 0x80);
+		value >>= 7;
+	}
+	out += (char)value;
+}
+
+struct exchange_reader {
+	const unsigned char* pos;
+	const unsigned char* end;
+	bool ok;
+};
+
+/* A value beyond 64 bits or cut off sets ok to false */
+static unsigned long long get_varint(exchange_reader& in) {
+	unsigned long long value = 0;
+	for (int shift = 0; shift < 64; shift += 7) {
+		if (in.pos == in.end) break;
+		unsigned char byte = *in.pos++;
+		if (shift == 63 && (byte & 0x7E)) break;
+		value |= (unsigned long long)(byte & 0x7F) << shift;
+		if (!(byte & 0x80)) return value;
+	}
+	in.ok = false;
+	return 0;
+}
+
+static void put_client_id(std::string& out, anyID id, anyID& previous) {
+	put_varint(out, (anyID)(id - previous));
+	previous = id;
+}
+
+static bool get_client_id(exchange_reader& in, anyID& previous) {
+	unsigned long long delta = get_varint(in);
+	if (!in.ok || delta > 0xFFFF) return false;
+	previous = (anyID)(previous + delta);
+	return true;
+}
+
+static std::string exchange_header(exchange_type type, anyID sender) {
+	std::string message;
+	message += (char)EXCHANGE_VERSION;
+	message += (char)type;
+	put_varint(message, sender);
+	return message;
+}
+
+static std::string exchange_command(const std::string& message) {
+	return EXCHANGE_PREFIX + base64_encode(message);
+}
+
+/* Asks for clients from the front of the list until the message is full. asked is set to the number that fit. */
+static std::string encode_exchange_request(anyID sender, const std::vector<anyID>& clients, size_t& asked) {
+	std::string entries;
+	size_t room = EXCHANGE_MAX_MESSAGE_BYTES - exchange_header(EXCHANGE_REQUEST, sender).size() - 3;  /* count */
+	anyID previous = 0;
+	asked = 0;
+	while (asked < clients.size() && entries.size() + 3 <= room) {
+		put_client_id(entries, clients[asked++], previous);
+	}
+	std::string message = exchange_header(EXCHANGE_REQUEST, sender);
+	put_varint(message, asked);
+	return exchange_command(message + entries);
+}
+
+/* Times are sent relative to now. answered is set to the number of entries that fit. */
+static std::string encode_exchange_answer(anyID sender, long long now, const std::vector<exchange_entry>& entries, size_t& answered) {
+	std::string encoded_entries;
+	size_t room = EXCHANGE_MAX_MESSAGE_BYTES - exchange_header(EXCHANGE_ANSWER, sender).size() - 10 - 3;  /* base time, count */
+	anyID previous = 0;
+	answered = 0;
+	for (size_t i = 0; i < entries.size(); i++) {
+		const exchange_entry& entry = entries[i];
+		std::string encoded;
+		anyID encoded_previous = previous;
+		put_client_id(encoded, entry.client, encoded_previous);
+		put_varint(encoded, now > entry.first_seen ? now - entry.first_seen : 0);
+		put_varint(encoded, entry.previous_visit ? (now > entry.previous_visit ? now - entry.previous_visit : 0) + 1 : 0);
+		put_varint(encoded, entry.visits);
+		if (encoded_entries.size() + encoded.size() > room) break;
+		encoded_entries += encoded;
+		previous = encoded_previous;
+		answered++;
+	}
+	std::string message = exchange_header(EXCHANGE_ANSWER, sender);
+	put_varint(message, now > 0 ? (unsigned long long)now : 0);
+	put_varint(message, answered);
+	return exchange_command(message + encoded_entries);
+}
+
+static bool is_exchange_command(const char* command) {
+	return strncmp(command, EXCHANGE_PREFIX, sizeof(EXCHANGE_PREFIX) - 1) == 0;
+}
+
+/* False if the command is malformed, of another version or type, or has bytes left over */
+static bool decode_exchange_command(const char* command, exchange_message& out) {
+	std::string message;
+	if (!is_exchange_command(command) || !base64_decode(command + sizeof(EXCHANGE_PREFIX) - 1, message)) return false;
+	if (message.size() < 3 || message[0] != EXCHANGE_VERSION) return false;
+	exchange_reader in = { (const unsigned char*)message.data() + 2, (const unsigned char*)message.data() + message.size(), true };
+	out.type = message[1];
+	out.sender = 0;
+	out.base = 0;
+	out.clients.clear();
+	out.entries.clear();
+	if (!get_client_id(in, out.sender)) return false;
+
+	anyID id = 0;
+	if (out.type == EXCHANGE_REQUEST) {
+		unsigned long long count = get_varint(in);
+		for (unsigned long long i = 0; in.ok && i < count; i++) {
+			if (!get_client_id(in, id)) return false;
+			out.clients.push_back(id);
+		}
+	}
+	else if (out.type == EXCHANGE_ANSWER) {
+		unsigned long long base = get_varint(in);
+		unsigned long long count = get_varint(in);
+		if (base > INT64_MAX) return false;
+		out.base = (long long)base;
+		for (unsigned long long i = 0; in.ok && i < count; i++) {
+			exchange_entry entry;
+			if (!get_client_id(in, id)) return false;
+			entry.client = id;
+			unsigned long long first_age = get_varint(in);
+			unsigned long long previous_age = get_varint(in);
+			unsigned long long visits = get_varint(in);
+			if (first_age > base || previous_age > base + 1 || visits > UINT32_MAX) return false;
+			entry.first_seen = out.base - (long long)first_age;
+			entry.previous_visit = previous_age ? out.base - (long long)(previous_age - 1) : 0;
+			entry.visits = (unsigned int)visits;
+			out.entries.push_back(entry);
+		}
+	}
+	else {
+		return false;
+	}
+	return in.ok && in.pos == in.end;
+}
+
+struct exchange_loopback_result {
+	size_t request_bytes;
+	size_t answer_bytes;
+	size_t asked;
+	size_t answered;
+	bool decoded;  /* both messages came back as they were encoded */
+};
+
+/*
+Asks for clients as EXCHANGE_LOOPBACK_SENDER, answers from history the way a peer would and decodes the answer.
+Nothing is sent or stored.
+*/
+static exchange_loopback_result run_exchange_loopback(const std::vector<anyID>& clients, const std::vector<exchange_entry>& history, long long now) {
+	exchange_loopback_result result = {};
+	std::string request = encode_exchange_request(EXCHANGE_LOOPBACK_SENDER, clients, result.asked);
+	result.request_bytes = request.size();
+	exchange_message asked;
+	if (!decode_exchange_command(request.c_str(), asked) || asked.type != EXCHANGE_REQUEST || asked.sender != EXCHANGE_LOOPBACK_SENDER) return result;
+	if (asked.clients != std::vector<anyID>(clients.begin(), clients.begin() + result.asked)) return result;
+
+	std::vector<exchange_entry> known;
+	for (size_t i = 0; i < asked.clients.size(); i++) {
+		for (size_t j = 0; j < history.size(); j++) {
+			if (history[j].client == asked.clients[i]) known.push_back(history[j]);
+		}
+	}
+	std::string answer = encode_exchange_answer(1, now, known, result.answered);
+	result.answer_bytes = answer.size();
+	exchange_message answered;
+	if (!decode_exchange_command(answer.c_str(), answered) || answered.type != EXCHANGE_ANSWER || answered.entries.size() != result.answered) return result;
+	for (size_t i = 0; i < answered.entries.size(); i++) {
+		const exchange_entry& sent = known[i];
+		const exchange_entry& got = answered.entries[i];
+		if (got.client != sent.client || got.first_seen != sent.first_seen || got.previous_visit != sent.previous_visit || got.visits != sent.visits) return result;
+	}
+	result.decoded = true;
+	return result;
+}
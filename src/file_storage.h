@@ -0,0 +1,291 @@
+#pragma once
+
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+/*
+Summary of a channel's file browser, built by walking the tree with requestFileList.
+Only the directories still to visit are kept, file entries are folded into the totals as they stream in.
+A finished summary is kept until a file event on the connection invalidates it.
+*/
+
+#define MAX_FILELIST_IN_FLIGHT 4
+
+enum storage_state {
+	STORAGE_WALKING,
+	STORAGE_DONE
+};
+
+struct channel_storage {
+	storage_state state;
+	uint64 files;
+	uint64 directories;
+	uint64 total_size;
+	uint64 incomplete;
+	uint64 newest_time;
+	std::string newest_name;
+	std::string last_error;
+	std::deque<std::string> pending_dirs;
+	std::map<std::string, std::string> in_flight;  /* path -> return code, empty until storage_issue sends the request */
+};
+
+struct filelist_request {
+	uint64 channelID;
+	std::string path;
+	std::string return_code;
+};
+
+typedef std::pair<uint64, uint64> storage_key;  /* connection, channel */
+
+static std::map<storage_key, channel_storage> channel_storages;
+static std::mutex channel_storages_mutex;
+
+static std::string child_path(const std::string& path, const char* name) {
+	std::string child = path;
+	if (child.empty() || child[child.size() - 1] != '/') child += "/";
+	child += name;
+	return child;
+}
+
+/* Moves pending directories into flight while there is room. Caller holds the mutex and issues the requests after releasing it. */
+static void storage_pump(uint64 channelID, channel_storage& storage, std::vector<filelist_request>& requests) {
+	while (storage.in_flight.size() < MAX_FILELIST_IN_FLIGHT && !storage.pending_dirs.empty()) {
+		filelist_request request;
+		request.channelID = channelID;
+		request.path = storage.pending_dirs.front();
+		storage.pending_dirs.pop_front();
+		storage.in_flight[request.path] = "";
+		requests.push_back(request);
+	}
+	if (storage.in_flight.empty() && storage.pending_dirs.empty()) {
+		storage.state = STORAGE_DONE;
+	}
+}
+
+static std::string storage_error_string(unsigned int error) {
+	char* message;
+	if (ts3Functions.getErrorMessage(error, &message) != ERROR_ok) return "error " + std::to_string(error);
+	std::string result = message;
+	ts3Functions.freeMemory(message);
+	return result;
+}
+
+static bool storage_directory_done(channel_storage& storage, uint64 channelID, std::map<std::string, std::string>::iterator flight, std::vector<filelist_request>& requests);
+
+/*
+Return codes are created here, outside the lock, and stored only if the directory is still waiting for its request.
+A request the client refuses completes its directory with the error, which may move further directories into flight.
+*/
+static void storage_issue(uint64 serverConnectionHandlerID, std::vector<filelist_request> requests) {
+	for (size_t i = 0; i < requests.size(); i++) {
+		char return_code[RETURNCODE_BUFSIZE];
+		ts3Functions.createReturnCode(pluginID, return_code, RETURNCODE_BUFSIZE);
+		{
+			std::lock_guard<std::mutex> lock(channel_storages_mutex);
+			std::map<storage_key, channel_storage>::iterator it = channel_storages.find(storage_key(serverConnectionHandlerID, requests[i].channelID));
+			if (it == channel_storages.end()) continue;
+			std::map<std::string, std::string>::iterator flight = it->second.in_flight.find(requests[i].path);
+			if (flight == it->second.in_flight.end() || !flight->second.empty()) continue;  /* walk restarted or forgotten */
+			flight->second = return_code;
+		}
+		requests[i].return_code = return_code;
+		unsigned int error = ts3Functions.requestFileList(serverConnectionHandlerID, requests[i].channelID, "", requests[i].path.c_str(), requests[i].return_code.c_str());
+		if (error == ERROR_ok) continue;
+		std::string message = storage_error_string(error);
+		uint64 channelID = requests[i].channelID;
+		bool done;
+		{
+			std::lock_guard<std::mutex> lock(channel_storages_mutex);
+			std::map<storage_key, channel_storage>::iterator it = channel_storages.find(storage_key(serverConnectionHandlerID, channelID));
+			if (it == channel_storages.end()) continue;
+			std::map<std::string, std::string>::iterator flight = it->second.in_flight.find(requests[i].path);
+			if (flight == it->second.in_flight.end() || flight->second != requests[i].return_code) continue;
+			it->second.last_error = message;
+			done = storage_directory_done(it->second, channelID, flight, requests);
+		}
+		if (done) ts3Functions.requestInfoUpdate(serverConnectionHandlerID, PLUGIN_CHANNEL, channelID);
+	}
+}
+
+static std::string size_string(uint64 bytes) {
+	char buffer[32];
+	if (bytes >= 1000ull * 1000 * 1000) snprintf(buffer, sizeof(buffer), "%.2f GBYTE", bytes / 1e9);
+	else if (bytes >= 1000ull * 1000) snprintf(buffer, sizeof(buffer), "%.2f MBYTE", bytes / 1e6);
+	else if (bytes >= 1000) snprintf(buffer, sizeof(buffer), "%.2f KBYTE", bytes / 1e3);
+	else snprintf(buffer, sizeof(buffer), "%llu BYTE", (unsigned long long)bytes);
+	return buffer;
+}
+
+/* Starts a walk if the channel has no summary yet and returns what is known so far */
+std::string channel_storage_string(uint64 serverConnectionHandlerID, uint64 channelID) {
+	std::vector<filelist_request> requests;
+	std::string result;
+	{
+		std::lock_guard<std::mutex> lock(channel_storages_mutex);
+		storage_key key(serverConnectionHandlerID, channelID);
+		std::map<storage_key, channel_storage>::iterator it = channel_storages.find(key);
+		if (it == channel_storages.end()) {
+			if (!connection_open(serverConnectionHandlerID)) return result;
+			channel_storage& storage = channel_storages[key];
+			storage.state = STORAGE_WALKING;
+			storage.files = storage.directories = storage.total_size = storage.incomplete = storage.newest_time = 0;
+			storage.pending_dirs.push_back("/");
+			storage_pump(channelID, storage, requests);
+			it = channel_storages.find(key);
+		}
+		const channel_storage& storage = it->second;
+
+		result += "files: [B]";
+		result += std::to_string(storage.files);
+		result += "[/B] in [B]";
+		result += std::to_string(storage.directories);
+		result += "[/B] folders";
+		if (storage.state == STORAGE_WALKING) result += " (scanning...)";
+		result += "\n";
+		result += "total size: [B]";
+		result += size_string(storage.total_size);
+		result += "[/B]\n";
+		result += "incomplete uploads: [B]";
+		result += std::to_string(storage.incomplete);
+		result += "[/B]\n";
+		if (!storage.newest_name.empty()) {
+			result += "newest file: [B]";
+			result += bbcode_escape(storage.newest_name);
+			result += "[/B] (";
+			result += get_time_string((int)storage.newest_time);
+			result += ")\n";
+		}
+		if (!storage.last_error.empty()) {
+			result += "file list error: [B]";
+			result += storage.last_error;
+			result += "[/B]\n";
+		}
+	}
+	storage_issue(serverConnectionHandlerID, requests);
+	return result;
+}
+
+void channel_storage_entry(uint64 serverConnectionHandlerID, uint64 channelID, const char* path, const char* name, uint64 size, uint64 datetime, int type, uint64 incompletesize, const char* returnCode) {
+	std::lock_guard<std::mutex> lock(channel_storages_mutex);
+	std::map<storage_key, channel_storage>::iterator it = channel_storages.find(storage_key(serverConnectionHandlerID, channelID));
+	if (it == channel_storages.end() || it->second.state != STORAGE_WALKING) return;
+	channel_storage& storage = it->second;
+	/* Listings the user opened in the file browser arrive here as well */
+	std::map<std::string, std::string>::const_iterator flight = storage.in_flight.find(path);
+	if (!returnCode || !*returnCode || flight == storage.in_flight.end() || flight->second != returnCode) return;
+
+	if (type == FileListType_Directory) {
+		storage.directories++;
+		storage.pending_dirs.push_back(child_path(path, name));
+		return;
+	}
+	storage.files++;
+	storage.total_size += size;
+	if (incompletesize > 0) storage.incomplete++;
+	if (datetime >= storage.newest_time) {
+		storage.newest_time = datetime;
+		storage.newest_name = child_path(path, name);
+	}
+}
+
+/*
+A directory is complete either through onFileListFinishedEvent or through the error event carrying its return code.
+Returns true once the whole walk is done.
+*/
+static bool storage_directory_done(channel_storage& storage, uint64 channelID, std::map<std::string, std::string>::iterator flight, std::vector<filelist_request>& requests) {
+	storage.in_flight.erase(flight);
+	storage_pump(channelID, storage, requests);
+	return storage.state == STORAGE_DONE;
+}
+
+/* Issues the follow-up requests and refreshes the channel panel, outside the lock since the client may call back into infoData */
+static void storage_continue(uint64 serverConnectionHandlerID, uint64 channelID, bool done, std::vector<filelist_request>& requests) {
+	storage_issue(serverConnectionHandlerID, requests);
+	if (done) {
+		ts3Functions.requestInfoUpdate(serverConnectionHandlerID, PLUGIN_CHANNEL, channelID);
+	}
+}
+
+void channel_storage_finished(uint64 serverConnectionHandlerID, uint64 channelID, const char* path) {
+	std::vector<filelist_request> requests;
+	bool done;
+	{
+		std::lock_guard<std::mutex> lock(channel_storages_mutex);
+		std::map<storage_key, channel_storage>::iterator it = channel_storages.find(storage_key(serverConnectionHandlerID, channelID));
+		if (it == channel_storages.end()) return;
+		std::map<std::string, std::string>::iterator flight = it->second.in_flight.find(path);
+		if (flight == it->second.in_flight.end()) return;
+		done = storage_directory_done(it->second, channelID, flight, requests);
+	}
+	storage_continue(serverConnectionHandlerID, channelID, done, requests);
+}
+
+/* Returns true if returnCode belonged to one of our file list requests */
+bool channel_storage_error(uint64 serverConnectionHandlerID, const char* returnCode, unsigned int error, const char* errorMessage) {
+	if (!returnCode || !*returnCode) return false;
+	std::vector<filelist_request> requests;
+	uint64 channelID = 0;
+	bool found = false;
+	bool done = false;
+	{
+		std::lock_guard<std::mutex> lock(channel_storages_mutex);
+		std::map<storage_key, channel_storage>::iterator it = channel_storages.lower_bound(storage_key(serverConnectionHandlerID, 0));
+		for (; !found && it != channel_storages.end() && it->first.first == serverConnectionHandlerID; ++it) {
+			std::map<std::string, std::string>::iterator flight = it->second.in_flight.begin();
+			while (flight != it->second.in_flight.end() && flight->second != returnCode) ++flight;
+			if (flight == it->second.in_flight.end()) continue;
+
+			/* An empty directory is reported as an error as well */
+			if (error != ERROR_ok && error != ERROR_database_empty_result) {
+				it->second.last_error = errorMessage;
+			}
+			channelID = it->first.second;
+			done = storage_directory_done(it->second, channelID, flight, requests);
+			found = true;
+		}
+	}
+	if (found) storage_continue(serverConnectionHandlerID, channelID, done, requests);
+	return found;
+}
+
+/* Any file transfer may have changed the tree, drop the connection's summaries so the next view walks again */
+void invalidate_channel_storage(uint64 serverConnectionHandlerID) {
+	std::lock_guard<std::mutex> lock(channel_storages_mutex);
+	std::map<storage_key, channel_storage>::iterator it = channel_storages.lower_bound(storage_key(serverConnectionHandlerID, 0));
+	while (it != channel_storages.end() && it->first.first == serverConnectionHandlerID) {
+		if (it->second.state == STORAGE_DONE) it = channel_storages.erase(it);
+		else ++it;
+	}
+}
+
+void forget_channel_storage(uint64 serverConnectionHandlerID, uint64 channelID) {
+	std::lock_guard<std::mutex> lock(channel_storages_mutex);
+	channel_storages.erase(storage_key(serverConnectionHandlerID, channelID));
+}
+
+/* Walks in progress too, answers to their requests find nothing and are ignored */
+void forget_channel_storages(uint64 serverConnectionHandlerID) {
+	std::lock_guard<std::mutex> lock(channel_storages_mutex);
+	std::map<storage_key, channel_storage>::iterator it = channel_storages.lower_bound(storage_key(serverConnectionHandlerID, 0));
+	while (it != channel_storages.end() && it->first.first == serverConnectionHandlerID) it = channel_storages.erase(it);
+}
+
+/* Approximate heap use of the connection's summaries */
+size_t channel_storages_bytes(uint64 serverConnectionHandlerID) {
+	size_t bytes = 0;
+	std::lock_guard<std::mutex> lock(channel_storages_mutex);
+	std::map<storage_key, channel_storage>::const_iterator it = channel_storages.lower_bound(storage_key(serverConnectionHandlerID, 0));
+	for (; it != channel_storages.end() && it->first.first == serverConnectionHandlerID; ++it) {
+		const channel_storage& storage = it->second;
+		bytes += sizeof(*it) + MAP_NODE_OVERHEAD + storage.newest_name.capacity() + storage.last_error.capacity();
+		for (size_t i = 0; i < storage.pending_dirs.size(); i++) bytes += sizeof(std::string) + storage.pending_dirs[i].capacity();
+		for (std::map<std::string, std::string>::const_iterator flight = storage.in_flight.begin(); flight != storage.in_flight.end(); ++flight) {
+			bytes += sizeof(*flight) + MAP_NODE_OVERHEAD + flight->first.capacity() + flight->second.capacity();
+		}
+	}
+	return bytes;
+}
@@ -0,0 +1,298 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <ctime>
+#include <map>
+#include <mutex>
+#include <set>
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "exchange_codec.h"
+
+/*
+Opt-in exchange of client history between users of this plugin on the same server (setting exchange=1).
+
+A request names visible clients and goes to every plugin user on the server; whoever knows some of them answers the
+requester alone with first sighting, previous visit and visit count. Answers are kept per connection by unique
+identifier and shown next to the own history. Nothing received is written to the own sightings log.
+
+The wire format is in exchange_codec.h. Requests start from where the last one stopped, so clients nobody knows do not
+keep the others out. Each connection sends at most one request per EXCHANGE_REQUEST_SECONDS and one answer per
+EXCHANGE_ANSWER_SECONDS, everything else is dropped.
+
+onPluginCommandEvent carries no invoker, so the sender ID in a message is only a claim. Sender 0 (it would turn an
+answer into a broadcast) and EXCHANGE_LOOPBACK_SENDER are rejected, and requests are answered only for senders that
+are visible clients. Answers are merged only for the clients of our own outstanding request, until
+EXCHANGE_ANSWER_WAIT_SECONDS after it was sent, at most one per sender and EXCHANGE_MAX_ANSWERS in all; anything else
+is counted as unsolicited and dropped.
+
+/kmi exchange loopback runs fixed clients and history entries through the codec (run_exchange_loopback), without the
+server and without touching the connection's answers.
+*/
+
+#define EXCHANGE_REQUEST_SECONDS 60
+#define EXCHANGE_ANSWER_SECONDS 10
+#define EXCHANGE_ANSWER_WAIT_SECONDS 30
+#define EXCHANGE_MAX_ANSWERS 8
+#define EXCHANGE_LOOPBACK_CLIENTS 400
+
+struct shared_history {
+	long long first_seen;
+	long long previous_visit;  /* 0 if none */
+	unsigned int visits;
+	unsigned int answers;
+};
+
+struct exchange_connection {
+	time_t last_request;
+	time_t last_answer;
+	anyID next_request_id;  /* requests continue from here */
+	std::set<anyID> asked;        /* clients of the outstanding request */
+	time_t asked_until;           /* answers to it are taken until then */
+	std::set<anyID> answered_by;  /* senders of the answers taken */
+	std::map<std::string, shared_history> shared;  /* by unique identifier */
+};
+
+struct exchange_stats {
+	std::atomic<unsigned long> sent;
+	std::atomic<unsigned long> received;
+	std::atomic<unsigned long> rejected;      /* malformed or another version */
+	std::atomic<unsigned long> rate_limited;
+	std::atomic<unsigned long> unsolicited;   /* answers to nothing we asked */
+};
+
+static std::map<uint64, exchange_connection> exchange_connections;
+static std::mutex exchange_mutex;
+static exchange_stats exchange_counts;
+
+static std::string exchange_uid(uint64 serverConnectionHandlerID, anyID clientID) {
+	char* uid;
+	if (ts3Functions.getClientVariableAsString(serverConnectionHandlerID, clientID, CLIENT_UNIQUE_IDENTIFIER, &uid) != ERROR_ok) return "";
+	std::string result = uid;
+	ts3Functions.freeMemory(uid);
+	return result;
+}
+
+static void exchange_send(uint64 serverConnectionHandlerID, const std::string& command, anyID target) {
+	anyID targets[2] = { target, 0 };
+	ts3Functions.sendPluginCommand(serverConnectionHandlerID, pluginID, command.c_str(), target ? PluginCommandTarget_CLIENT : PluginCommandTarget_SERVER, target ? targets : NULL, NULL);
+	exchange_counts.sent++;
+}
+
+/* Asks for the visible clients nobody answered for yet. Returns false if rate limited or there was nothing to ask. */
+static bool exchange_request(uint64 serverConnectionHandlerID, anyID ownID) {
+	if (!ownID) return false;
+	anyID* clients;
+	if (ts3Functions.getClientList(serverConnectionHandlerID, &clients) != ERROR_ok) return false;
+	std::vector<std::pair<anyID, std::string> > visible;
+	for (anyID* client = clients; *client; client++) {
+		if (*client != ownID) visible.push_back(std::make_pair(*client, exchange_uid(serverConnectionHandlerID, *client)));
+	}
+	ts3Functions.freeMemory(clients);
+
+	std::vector<anyID> ids;
+	{
+		std::lock_guard<std::mutex> lock(exchange_mutex);
+		if (!connection_open(serverConnectionHandlerID)) return false;
+		exchange_connection& connection = exchange_connections[serverConnectionHandlerID];
+		time_t now = time(NULL);
+		if (connection.last_request && now - connection.last_request < EXCHANGE_REQUEST_SECONDS) {
+			exchange_counts.rate_limited++;
+			return false;
+		}
+		for (size_t i = 0; i < visible.size(); i++) {
+			if (!visible[i].second.empty() && !connection.shared.count(visible[i].second)) ids.push_back(visible[i].first);
+		}
+		if (ids.empty()) return false;
+		std::sort(ids.begin(), ids.end());
+		std::rotate(ids.begin(), std::lower_bound(ids.begin(), ids.end(), connection.next_request_id), ids.end());
+		connection.last_request = now;
+	}
+
+	size_t asked;
+	std::string command = encode_exchange_request(ownID, ids, asked);
+	{
+		/* Before sending, answers may be quicker than the return of sendPluginCommand */
+		std::lock_guard<std::mutex> lock(exchange_mutex);
+		std::map<uint64, exchange_connection>::iterator it = exchange_connections.find(serverConnectionHandlerID);
+		if (it == exchange_connections.end()) return false;
+		it->second.next_request_id = (anyID)(ids[asked - 1] + 1);
+		it->second.asked = std::set<anyID>(ids.begin(), ids.begin() + asked);
+		it->second.asked_until = time(NULL) + EXCHANGE_ANSWER_WAIT_SECONDS;
+		it->second.answered_by.clear();
+	}
+	exchange_send(serverConnectionHandlerID, command, 0);
+	return true;
+}
+
+static void exchange_answer(uint64 serverConnectionHandlerID, anyID ownID, const exchange_message& request) {
+	if (exchange_uid(serverConnectionHandlerID, request.sender).empty()) {
+		exchange_counts.rejected++;  /* nobody we can see */
+		return;
+	}
+	long long now = (long long)time(NULL);
+	{
+		std::lock_guard<std::mutex> lock(exchange_mutex);
+		if (!connection_open(serverConnectionHandlerID)) return;
+		exchange_connection& connection = exchange_connections[serverConnectionHandlerID];
+		if (connection.last_answer && now - connection.last_answer < EXCHANGE_ANSWER_SECONDS) {
+			exchange_counts.rate_limited++;
+			return;
+		}
+	}
+	std::vector<exchange_entry> known;
+	for (size_t i = 0; i < request.clients.size(); i++) {
+		client_history history;
+		if (!find_client_history(exchange_uid(serverConnectionHandlerID, request.clients[i]), history)) continue;
+		exchange_entry entry = { request.clients[i], history.first_seen, history.previous_visit, history.visits };
+		known.push_back(entry);
+	}
+	size_t answered;
+	std::string command = encode_exchange_answer(ownID, now, known, answered);
+	if (!answered) return;
+
+	{
+		std::lock_guard<std::mutex> lock(exchange_mutex);
+		std::map<uint64, exchange_connection>::iterator it = exchange_connections.find(serverConnectionHandlerID);
+		if (it != exchange_connections.end()) it->second.last_answer = (time_t)now;
+	}
+	exchange_send(serverConnectionHandlerID, command, request.sender);
+}
+
+static void exchange_merge(uint64 serverConnectionHandlerID, const exchange_message& answer) {
+	std::vector<exchange_entry> entries;
+	{
+		std::lock_guard<std::mutex> lock(exchange_mutex);
+		std::map<uint64, exchange_connection>::iterator it = exchange_connections.find(serverConnectionHandlerID);
+		if (it == exchange_connections.end() || it->second.asked.empty() || time(NULL) > it->second.asked_until) {
+			exchange_counts.unsolicited++;
+			return;
+		}
+		if (it->second.answered_by.count(answer.sender) || it->second.answered_by.size() >= EXCHANGE_MAX_ANSWERS) {
+			exchange_counts.rate_limited++;
+			return;
+		}
+		it->second.answered_by.insert(answer.sender);
+		for (size_t i = 0; i < answer.entries.size(); i++) {
+			if (it->second.asked.count(answer.entries[i].client)) entries.push_back(answer.entries[i]);
+			else exchange_counts.unsolicited++;
+		}
+	}
+
+	std::vector<std::string> uids;
+	for (size_t i = 0; i < entries.size(); i++) uids.push_back(exchange_uid(serverConnectionHandlerID, entries[i].client));
+	std::lock_guard<std::mutex> lock(exchange_mutex);
+	std::map<uint64, exchange_connection>::iterator it = exchange_connections.find(serverConnectionHandlerID);
+	if (it == exchange_connections.end()) return;  /* closed meanwhile */
+	exchange_connection& connection = it->second;
+	for (size_t i = 0; i < entries.size(); i++) {
+		if (uids[i].empty()) continue;  /* left meanwhile */
+		const exchange_entry& entry = entries[i];
+		std::map<std::string, shared_history>::iterator known = connection.shared.find(uids[i]);
+		if (known == connection.shared.end()) {
+			shared_history shared = { entry.first_seen, entry.previous_visit, entry.visits, 1 };
+			connection.shared[uids[i]] = shared;
+			continue;
+		}
+		if (entry.first_seen < known->second.first_seen) known->second.first_seen = entry.first_seen;
+		if (entry.previous_visit > known->second.previous_visit) known->second.previous_visit = entry.previous_visit;
+		if (entry.visits > known->second.visits) known->second.visits = entry.visits;
+		known->second.answers++;
+	}
+}
+
+/* A command of another plugin user. Returns false if it is not one of ours. */
+static bool exchange_receive(uint64 serverConnectionHandlerID, anyID ownID, const char* command) {
+	if (!is_exchange_command(command)) return false;
+	exchange_message message;
+	if (!decode_exchange_command(command, message)) {
+		exchange_counts.rejected++;
+		return true;
+	}
+	if (message.sender == 0 || message.sender == EXCHANGE_LOOPBACK_SENDER) {
+		exchange_counts.rejected++;
+		return true;
+	}
+	if (message.sender == ownID) return true;  /* our own request coming back */
+	exchange_counts.received++;
+	if (message.type == EXCHANGE_REQUEST) exchange_answer(serverConnectionHandlerID, ownID, message);
+	else exchange_merge(serverConnectionHandlerID, message);
+	return true;
+}
+
+static anyID exchange_own_id(uint64 serverConnectionHandlerID) {
+	anyID own_id;
+	return ts3Functions.getClientID(serverConnectionHandlerID, &own_id) == ERROR_ok ? own_id : 0;
+}
+
+/* On connect and from /kmi exchange */
+bool request_shared_history(uint64 serverConnectionHandlerID) {
+	if (!exchange_enabled.load()) return false;
+	return exchange_request(serverConnectionHandlerID, exchange_own_id(serverConnectionHandlerID));
+}
+
+/* From onPluginCommandEvent */
+void exchange_plugin_command(uint64 serverConnectionHandlerID, const char* command) {
+	if (!exchange_enabled.load()) return;
+	exchange_receive(serverConnectionHandlerID, exchange_own_id(serverConnectionHandlerID), command);
+}
+
+/* /kmi exchange loopback: every third client ID, every other one with a history, at a fixed time */
+std::string exchange_loopback() {
+	const long long now = 1700000000;
+	std::vector<anyID> clients;
+	std::vector<exchange_entry> history;
+	for (anyID i = 1; i <= EXCHANGE_LOOPBACK_CLIENTS; i++) {
+		clients.push_back((anyID)(i * 3));
+		if (i % 2) continue;
+		exchange_entry entry = { (anyID)(i * 3), now - i * 86400LL, i % 4 ? now - i * 3600LL : 0, i };
+		history.push_back(entry);
+	}
+	exchange_loopback_result result = run_exchange_loopback(clients, history, now);
+	return "loopback: asked for " + std::to_string(result.asked) + " of " + std::to_string(clients.size()) + " clients in " + std::to_string(result.request_bytes)
+		+ " bytes, answered " + std::to_string(result.answered) + " in " + std::to_string(result.answer_bytes) + " bytes"
+		+ (result.decoded ? ", decoded" : ", DECODING FAILED");
+}
+
+/* For the history section, empty if nobody answered for the client */
+std::string shared_history_string(uint64 serverConnectionHandlerID, anyID clientID) {
+	std::string uid = exchange_uid(serverConnectionHandlerID, clientID);
+	shared_history entry;
+	{
+		std::lock_guard<std::mutex> lock(exchange_mutex);
+		std::map<uint64, exchange_connection>::const_iterator connection = exchange_connections.find(serverConnectionHandlerID);
+		if (connection == exchange_connections.end()) return "";
+		std::map<std::string, shared_history>::const_iterator it = connection->second.shared.find(uid);
+		if (it == connection->second.shared.end()) return "";
+		entry = it->second;
+	}
+	std::string result = "first seen [B]" + get_time_string((int)entry.first_seen) + "[/B], [B]" + std::to_string(entry.visits) + "[/B] visits";
+	if (entry.previous_visit) result += ", last visit [B]" + age_string((long long)time(NULL) - entry.previous_visit) + " ago[/B]";
+	return result + " (" + std::to_string(entry.answers) + (entry.answers == 1 ? " answer)" : " answers)");
+}
+
+void forget_shared_history(uint64 serverConnectionHandlerID) {
+	std::lock_guard<std::mutex> lock(exchange_mutex);
+	exchange_connections.erase(serverConnectionHandlerID);
+}
+
+size_t shared_history_bytes(uint64 serverConnectionHandlerID) {
+	std::lock_guard<std::mutex> lock(exchange_mutex);
+	std::map<uint64, exchange_connection>::const_iterator connection = exchange_connections.find(serverConnectionHandlerID);
+	if (connection == exchange_connections.end()) return 0;
+	size_t bytes = sizeof(*connection) + MAP_NODE_OVERHEAD;
+	for (std::map<std::string, shared_history>::const_iterator it = connection->second.shared.begin(); it != connection->second.shared.end(); ++it) {
+		bytes += sizeof(*it) + MAP_NODE_OVERHEAD + it->first.capacity();
+	}
+	return bytes;
+}
+
+std::string exchange_stats_string() {
+	return std::string(exchange_enabled.load() ? "on" : "off") + ", " + std::to_string(exchange_counts.sent.load()) + " sent, " + std::to_string(exchange_counts.received.load()) + " received, "
+		+ std::to_string(exchange_counts.rejected.load()) + " rejected, " + std::to_string(exchange_counts.rate_limited.load()) + " rate limited, "
+		+ std::to_string(exchange_counts.unsolicited.load()) + " unsolicited";
+}
@@ -0,0 +1,385 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "utf8_file.h"
+
+/*
+Info layout templates.
+
+The layout file holds one template per panel, each starting with a [[server]], [[channel]] or [[client]] line.
+Inside a template:
+	{{name}}                     value of a field
+	{{#if name}}..{{else}}..{{/if}}  rendered if the field is neither empty nor "0"
+	{{#section name}}..{{/section}}  named block that can be switched off as a whole
+	{{! comment }}
+A line holding nothing but a block tag is dropped completely, so tags can sit on their own lines.
+
+Templates are compiled once into a flat instruction list. Rendering only walks that list, fetching each
+field the first time an instruction needs it, so fields inside skipped blocks are never fetched.
+*/
+
+#define LAYOUT_FILENAME "KeyinatorsMoreInfo_layout.txt"
+#define LAYOUT_PANELS 3
+#define LAYOUT_MAX_SECTIONS 64
+
+enum layout_op {
+	OP_TEXT,           /* append text[offset, offset + length) */
+	OP_FIELD,          /* append value of field arg */
+	OP_JUMP_IF_EMPTY,  /* jump to offset if field arg is empty or "0" */
+	OP_JUMP,           /* jump to offset */
+	OP_SECTION         /* jump to offset if section arg is disabled */
+};
+
+struct layout_instruction {
+	unsigned char op;
+	unsigned short arg;
+	unsigned int offset;
+	unsigned int length;
+};
+
+struct layout_program {
+	std::vector<layout_instruction> code;
+	std::string text;
+};
+
+/* Writes the value into value, which keeps its buffer from earlier renders */
+typedef void(*layout_fetch)(uint64 serverConnectionHandlerID, uint64 id, std::string& value);
+
+struct layout_field {
+	const char* name;
+	layout_fetch fetch;
+	bool escape;  /* the value is raw text, escaped while it is appended to the panel */
+};
+
+struct layout_fields {
+	const layout_field* fields;
+	size_t count;
+};
+
+/*
+Section names are global so a section can be switched off in every panel that uses it.
+Names are only added while compiling; the flags are atomic since the settings may change them from another thread.
+*/
+static std::vector<std::string> layout_section_names;
+static std::atomic<bool> layout_section_disabled[LAYOUT_MAX_SECTIONS];
+static std::mutex layout_sections_mutex;
+
+static std::shared_ptr<const layout_program> layout_programs[LAYOUT_PANELS];
+
+static int layout_section_id(const std::string& name) {
+	std::lock_guard<std::mutex> lock(layout_sections_mutex);
+	for (size_t i = 0; i < layout_section_names.size(); i++) {
+		if (layout_section_names[i] == name) return (int)i;
+	}
+	if (layout_section_names.size() == LAYOUT_MAX_SECTIONS) return -1;
+	layout_section_names.push_back(name);
+	return (int)layout_section_names.size() - 1;
+}
+
+static int layout_field_id(const layout_fields& fields, const std::string& name) {
+	for (size_t i = 0; i < fields.count; i++) {
+		if (name == fields.fields[i].name) return (int)i;
+	}
+	return -1;
+}
+
+static std::string trim(const std::string& s) {
+	size_t begin = s.find_first_not_of(" \t");
+	if (begin == std::string::npos) return "";
+	size_t end = s.find_last_not_of(" \t");
+	return s.substr(begin, end - begin + 1);
+}
+
+/* Text runs merge with the previous run unless a jump lands between them, which happens after dropped tag lines */
+static void layout_emit_text(layout_program& program, const std::string& source, size_t begin, size_t end, size_t label) {
+	if (end <= begin) return;
+	layout_instruction instruction = { OP_TEXT, 0, (unsigned int)program.text.size(), (unsigned int)(end - begin) };
+	program.text.append(source, begin, end - begin);
+	if (program.code.size() > label && program.code.back().op == OP_TEXT && program.code.back().offset + program.code.back().length == instruction.offset) {
+		program.code.back().length += instruction.length;
+		return;
+	}
+	program.code.push_back(instruction);
+}
+
+/*
+Compiles one panel template. Returns false and fills error on unknown fields or unbalanced blocks.
+*/
+bool compile_layout(const std::string& source, const layout_fields& fields, layout_program& program, std::string& error) {
+	struct open_block {
+		char kind;  /* 'i' if, 'e' else, 's' section */
+		size_t at;
+	};
+	std::vector<open_block> blocks;
+	size_t pos = 0;
+	size_t text_begin = 0;
+	size_t label = 0;  /* code index of the last jump target */
+
+	while (true) {
+		size_t open = source.find("{{", pos);
+		if (open == std::string::npos) break;
+		size_t close = source.find("}}", open + 2);
+		if (close == std::string::npos) {
+			error = "unterminated {{";
+			return false;
+		}
+		std::string tag = trim(source.substr(open + 2, close - open - 2));
+		size_t tag_end = close + 2;
+		bool block_tag = !tag.empty() && (tag[0] == '#' || tag[0] == '/' || tag[0] == '!' || tag == "else");
+
+		/* Block tags alone on a line swallow the whole line */
+		size_t emit_end = open;
+		if (block_tag) {
+			size_t line_begin = source.rfind('\n', open);
+			line_begin = line_begin == std::string::npos ? 0 : line_begin + 1;
+			size_t line_end = source.find('\n', tag_end);
+			if (line_begin >= text_begin
+				&& source.find_first_not_of(" \t", line_begin) == open
+				&& (line_end == std::string::npos ? source.find_first_not_of(" \t", tag_end) == std::string::npos : source.find_first_not_of(" \t", tag_end) == line_end)) {
+				emit_end = line_begin;
+				tag_end = line_end == std::string::npos ? source.size() : line_end + 1;
+			}
+		}
+		layout_emit_text(program, source, text_begin, emit_end, label);
+		text_begin = pos = tag_end;
+
+		if (tag[0] == '!') {
+			continue;
+		}
+		if (tag.compare(0, 4, "#if ") == 0) {
+			int field = layout_field_id(fields, trim(tag.substr(4)));
+			if (field < 0) {
+				error = "unknown field in {{" + tag + "}}";
+				return false;
+			}
+			layout_instruction instruction = { OP_JUMP_IF_EMPTY, (unsigned short)field, 0, 0 };
+			blocks.push_back(open_block{ 'i', program.code.size() });
+			program.code.push_back(instruction);
+		}
+		else if (tag.compare(0, 9, "#section ") == 0) {
+			int section = layout_section_id(trim(tag.substr(9)));
+			if (section < 0) {
+				error = "too many sections";
+				return false;
+			}
+			layout_instruction instruction = { OP_SECTION, (unsigned short)section, 0, 0 };
+			blocks.push_back(open_block{ 's', program.code.size() });
+			program.code.push_back(instruction);
+		}
+		else if (tag == "else") {
+			if (blocks.empty() || blocks.back().kind != 'i') {
+				error = "{{else}} outside of {{#if}}";
+				return false;
+			}
+			layout_instruction instruction = { OP_JUMP, 0, 0, 0 };
+			program.code.push_back(instruction);
+			program.code[blocks.back().at].offset = (unsigned int)program.code.size();
+			label = program.code.size();
+			blocks.back().kind = 'e';
+			blocks.back().at = program.code.size() - 1;
+		}
+		else if (tag == "/if" || tag == "/section") {
+			char expected = tag == "/if" ? 'i' : 's';
+			if (blocks.empty() || (blocks.back().kind != expected && !(expected == 'i' && blocks.back().kind == 'e'))) {
+				error = "unbalanced {{" + tag + "}}";
+				return false;
+			}
+			program.code[blocks.back().at].offset = (unsigned int)program.code.size();
+			label = program.code.size();
+			blocks.pop_back();
+		}
+		else {
+			int field = layout_field_id(fields, tag);
+			if (field < 0) {
+				error = "unknown field {{" + tag + "}}";
+				return false;
+			}
+			layout_instruction instruction = { OP_FIELD, (unsigned short)field, 0, 0 };
+			program.code.push_back(instruction);
+		}
+	}
+	layout_emit_text(program, source, text_begin, source.size(), label);
+
+	if (!blocks.empty()) {
+		error = "unclosed block";
+		return false;
+	}
+	return true;
+}
+
+static bool layout_truthy(const std::string& value) {
+	return !value.empty() && value != "0";
+}
+
+/* Field values of one render. Values marked fetched beforehand are used as they are, without calling the SDK. */
+struct layout_values {
+	std::vector<std::string> values;
+	std::vector<bool> fetched;
+
+	void reset(size_t count) {
+		values.resize(count);
+		fetched.assign(count, false);
+	}
+};
+
+/*
+Value sets are recycled, so the value strings keep their buffers from one render to the next instead of being
+allocated for every field of every render. Renders on different threads each take their own set.
+*/
+#define LAYOUT_MAX_FREE_VALUES 8
+
+static std::vector<layout_values*> layout_values_free;
+static std::mutex layout_values_mutex;
+
+/* A reset value set for the lifetime of one render */
+struct reused_layout_values {
+	layout_values* values;
+
+	explicit reused_layout_values(size_t count) : values(NULL) {
+		{
+			std::lock_guard<std::mutex> lock(layout_values_mutex);
+			if (!layout_values_free.empty()) {
+				values = layout_values_free.back();
+				layout_values_free.pop_back();
+			}
+		}
+		if (!values) values = new layout_values();
+		values->reset(count);
+	}
+
+	~reused_layout_values() {
+		std::lock_guard<std::mutex> lock(layout_values_mutex);
+		if (layout_values_free.size() < LAYOUT_MAX_FREE_VALUES) layout_values_free.push_back(values);
+		else delete values;
+	}
+
+	reused_layout_values(const reused_layout_values&) = delete;
+	reused_layout_values& operator=(const reused_layout_values&) = delete;
+};
+
+/* From ts3plugin_shutdown */
+void release_layout_values() {
+	std::lock_guard<std::mutex> lock(layout_values_mutex);
+	for (size_t i = 0; i < layout_values_free.size(); i++) delete layout_values_free[i];
+	layout_values_free.clear();
+}
+
+/* Appends the panel to out, escaped text fields go there without an intermediate copy */
+void render_layout(const layout_program& program, const layout_fields& fields, uint64 serverConnectionHandlerID, uint64 id, layout_values& field_values, pool_string& out) {
+	std::vector<std::string>& values = field_values.values;
+	std::vector<bool>& fetched = field_values.fetched;
+	out.reserve(out.size() + program.text.size());
+
+	size_t pc = 0;
+	while (pc < program.code.size()) {
+		const layout_instruction& instruction = program.code[pc];
+		switch (instruction.op) {
+			case OP_TEXT:
+				out.append(program.text, instruction.offset, instruction.length);
+				pc++;
+				break;
+			case OP_FIELD:
+			case OP_JUMP_IF_EMPTY:
+				if (!fetched[instruction.arg]) {
+					fields.fields[instruction.arg].fetch(serverConnectionHandlerID, id, values[instruction.arg]);
+					fetched[instruction.arg] = true;
+				}
+				if (instruction.op == OP_FIELD) {
+					const std::string& value = values[instruction.arg];
+					if (fields.fields[instruction.arg].escape) bbcode_escape_append(value.data(), value.size(), out);
+					else out += value;
+					pc++;
+				}
+				else {
+					pc = layout_truthy(values[instruction.arg]) ? pc + 1 : instruction.offset;
+				}
+				break;
+			case OP_JUMP:
+				pc = instruction.offset;
+				break;
+			case OP_SECTION:
+				pc = layout_section_disabled[instruction.arg].load(std::memory_order_relaxed) ? instruction.offset : pc + 1;
+				break;
+		}
+	}
+}
+
+/* Start of the first line from `from` on that holds nothing but marker, or npos. The marker may appear in template text. */
+static size_t find_marker_line(const std::string& text, const char* marker, size_t from) {
+	size_t length = strlen(marker);
+	for (size_t at = text.find(marker, from); at != std::string::npos; at = text.find(marker, at + 1)) {
+		bool line_start = at == 0 || text[at - 1] == '\n';
+		bool line_end = at + length == text.size() || text[at + length] == '\n';
+		if (line_start && line_end) return at;
+	}
+	return std::string::npos;
+}
+
+/*
+Splits the layout file into its panel templates and compiles them. A panel that is missing or fails to compile
+keeps the built-in default, the reason is appended to errors.
+*/
+void load_layout(const std::string& source, const std::string& default_source, const layout_fields* panel_fields, std::string& errors) {
+	static const char* panel_names[LAYOUT_PANELS] = { "[[server]]", "[[channel]]", "[[client]]" };
+
+	for (int panel = 0; panel < LAYOUT_PANELS; panel++) {
+		std::shared_ptr<layout_program> program = std::make_shared<layout_program>();
+		bool compiled = false;
+		std::string error;
+
+		const std::string* sources[2] = { &source, &default_source };
+		for (int s = 0; s < 2 && !compiled; s++) {
+			const std::string& text = *sources[s];
+			size_t header = find_marker_line(text, panel_names[panel], 0);
+			if (header == std::string::npos) {
+				if (s == 0) errors += std::string(panel_names[panel]) + " missing, using default\n";
+				continue;
+			}
+			size_t begin = text.find('\n', header);
+			begin = begin == std::string::npos ? text.size() : begin + 1;
+			size_t end = text.size();
+			for (int other = 0; other < LAYOUT_PANELS; other++) {
+				size_t next = find_marker_line(text, panel_names[other], begin);
+				if (next < end) end = next;
+			}
+
+			*program = layout_program();
+			compiled = compile_layout(text.substr(begin, end - begin), panel_fields[panel], *program, error);
+			if (!compiled && s == 0) errors += std::string(panel_names[panel]) + " " + error + ", using default\n";
+		}
+		std::atomic_store(&layout_programs[panel], std::shared_ptr<const layout_program>(program));
+	}
+}
+
+std::shared_ptr<const layout_program> current_layout(int panel) {
+	return std::atomic_load(&layout_programs[panel]);
+}
+
+static bool read_file(const std::string& path, std::string& content) {
+	FILE* file = utf8_fopen(path, "rb");
+	if (!file) return false;
+	char buffer[4096];
+	size_t n;
+	content.clear();
+	while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+		for (size_t i = 0; i < n; i++) {
+			if (buffer[i] != '\r') content += buffer[i];
+		}
+	}
+	fclose(file);
+	return true;
+}
+
+static bool write_file(const std::string& path, const std::string& content) {
+	FILE* file = utf8_fopen(path, "wb");
+	if (!file) return false;
+	bool ok = fwrite(content.data(), 1, content.size(), file) == content.size();
+	return fclose(file) == 0 && ok;
+}
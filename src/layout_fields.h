@@ -0,0 +1,593 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/*
+Fields offered to the layout templates of the three panels, and the built-in default layout.
+VIRTUALSERVER_HOSTBANNER_* are not offered, fetching them here crashed the client.
+*/
+
+/* SDK variable getters called while rendering, reported by /kmi stats */
+static std::atomic<unsigned long> sdk_variable_calls(0);
+static std::atomic<unsigned long> last_render_sdk_calls[LAYOUT_PANELS];
+static std::atomic<size_t> last_render_bytes[LAYOUT_PANELS];
+
+/*
+Typed getters. The overload, and with it the SDK getter, is picked by the type of value, so numbers never pass
+through a string until they are formatted for the panel.
+*/
+/* Takes over an SDK allocated string */
+static bool sdk_string(char* value, std::string& result) {
+	result = value;
+	ts3Functions.freeMemory(value);
+	return true;
+}
+
+static bool server_value(uint64 serverConnectionHandlerID, size_t flag, std::string& result) {
+	char* value;
+	sdk_variable_calls++;
+	return ts3Functions.getServerVariableAsString(serverConnectionHandlerID, flag, &value) == ERROR_ok && sdk_string(value, result);
+}
+
+static bool server_value(uint64 serverConnectionHandlerID, size_t flag, int& result) {
+	sdk_variable_calls++;
+	return ts3Functions.getServerVariableAsInt(serverConnectionHandlerID, flag, &result) == ERROR_ok;
+}
+
+static bool server_value(uint64 serverConnectionHandlerID, size_t flag, uint64& result) {
+	sdk_variable_calls++;
+	return ts3Functions.getServerVariableAsUInt64(serverConnectionHandlerID, flag, &result) == ERROR_ok;
+}
+
+static bool channel_value(uint64 serverConnectionHandlerID, uint64 channelID, size_t flag, std::string& result) {
+	char* value;
+	sdk_variable_calls++;
+	return ts3Functions.getChannelVariableAsString(serverConnectionHandlerID, channelID, flag, &value) == ERROR_ok && sdk_string(value, result);
+}
+
+static bool channel_value(uint64 serverConnectionHandlerID, uint64 channelID, size_t flag, int& result) {
+	sdk_variable_calls++;
+	return ts3Functions.getChannelVariableAsInt(serverConnectionHandlerID, channelID, flag, &result) == ERROR_ok;
+}
+
+static bool channel_value(uint64 serverConnectionHandlerID, uint64 channelID, size_t flag, uint64& result) {
+	sdk_variable_calls++;
+	return ts3Functions.getChannelVariableAsUInt64(serverConnectionHandlerID, channelID, flag, &result) == ERROR_ok;
+}
+
+static bool client_value(uint64 serverConnectionHandlerID, anyID clientID, size_t flag, std::string& result) {
+	char* value;
+	sdk_variable_calls++;
+	return ts3Functions.getClientVariableAsString(serverConnectionHandlerID, clientID, flag, &value) == ERROR_ok && sdk_string(value, result);
+}
+
+static bool client_value(uint64 serverConnectionHandlerID, anyID clientID, size_t flag, int& result) {
+	sdk_variable_calls++;
+	return ts3Functions.getClientVariableAsInt(serverConnectionHandlerID, clientID, flag, &result) == ERROR_ok;
+}
+
+static bool client_value(uint64 serverConnectionHandlerID, anyID clientID, size_t flag, uint64& result) {
+	sdk_variable_calls++;
+	return ts3Functions.getClientVariableAsUInt64(serverConnectionHandlerID, clientID, flag, &result) == ERROR_ok;
+}
+
+static std::string client_string(uint64 serverConnectionHandlerID, anyID clientID, size_t flag) {
+	std::string result;
+	client_value(serverConnectionHandlerID, clientID, flag, result);
+	return result;
+}
+
+/*
+SDK type of the numeric variables offered as fields. Variables not listed here are fetched as strings.
+*/
+template <size_t flag> struct server_variable { typedef std::string type; };
+template <size_t flag> struct channel_variable { typedef std::string type; };
+template <size_t flag> struct client_variable { typedef std::string type; };
+
+#define SERVER_VARIABLE(flag, value_type) template <> struct server_variable<flag> { typedef value_type type; };
+#define CHANNEL_VARIABLE(flag, value_type) template <> struct channel_variable<flag> { typedef value_type type; };
+#define CLIENT_VARIABLE(flag, value_type) template <> struct client_variable<flag> { typedef value_type type; };
+
+SERVER_VARIABLE(VIRTUALSERVER_ID, uint64)
+SERVER_VARIABLE(VIRTUALSERVER_MAXCLIENTS, int)
+SERVER_VARIABLE(VIRTUALSERVER_CLIENTS_ONLINE, int)
+SERVER_VARIABLE(VIRTUALSERVER_CREATED, int)
+SERVER_VARIABLE(VIRTUALSERVER_UPTIME, int)
+SERVER_VARIABLE(VIRTUALSERVER_CODEC_ENCRYPTION_MODE, int)
+SERVER_VARIABLE(VIRTUALSERVER_DEFAULT_SERVER_GROUP, uint64)
+SERVER_VARIABLE(VIRTUALSERVER_DEFAULT_CHANNEL_GROUP, uint64)
+SERVER_VARIABLE(VIRTUALSERVER_DEFAULT_CHANNEL_ADMIN_GROUP, uint64)
+SERVER_VARIABLE(VIRTUALSERVER_MAX_UPLOAD_TOTAL_BANDWIDTH, uint64)
+SERVER_VARIABLE(VIRTUALSERVER_MAX_DOWNLOAD_TOTAL_BANDWIDTH, uint64)
+SERVER_VARIABLE(VIRTUALSERVER_MIN_CLIENT_VERSION, int)
+SERVER_VARIABLE(VIRTUALSERVER_MIN_ANDROID_VERSION, int)
+SERVER_VARIABLE(VIRTUALSERVER_MIN_IOS_VERSION, int)
+SERVER_VARIABLE(VIRTUALSERVER_MIN_WINPHONE_VERSION, int)
+SERVER_VARIABLE(VIRTUALSERVER_PORT, int)
+SERVER_VARIABLE(VIRTUALSERVER_COMPLAIN_AUTOBAN_COUNT, int)
+SERVER_VARIABLE(VIRTUALSERVER_COMPLAIN_AUTOBAN_TIME, int)
+SERVER_VARIABLE(VIRTUALSERVER_COMPLAIN_REMOVE_TIME, int)
+SERVER_VARIABLE(VIRTUALSERVER_UPLOAD_QUOTA, uint64)
+SERVER_VARIABLE(VIRTUALSERVER_DOWNLOAD_QUOTA, uint64)
+SERVER_VARIABLE(VIRTUALSERVER_ANTIFLOOD_POINTS_TICK_REDUCE, int)
+SERVER_VARIABLE(VIRTUALSERVER_ANTIFLOOD_POINTS_NEEDED_COMMAND_BLOCK, int)
+SERVER_VARIABLE(VIRTUALSERVER_ANTIFLOOD_POINTS_NEEDED_IP_BLOCK, int)
+
+CHANNEL_VARIABLE(CHANNEL_ORDER, uint64)
+CHANNEL_VARIABLE(CHANNEL_DELETE_DELAY, int)
+CHANNEL_VARIABLE(CHANNEL_MAXCLIENTS, int)
+CHANNEL_VARIABLE(CHANNEL_NEEDED_TALK_POWER, int)
+
+CLIENT_VARIABLE(CLIENT_INPUT_MUTED, int)
+CLIENT_VARIABLE(CLIENT_OUTPUT_MUTED, int)
+CLIENT_VARIABLE(CLIENT_INPUT_HARDWARE, int)
+CLIENT_VARIABLE(CLIENT_OUTPUT_HARDWARE, int)
+CLIENT_VARIABLE(CLIENT_AWAY, int)
+CLIENT_VARIABLE(CLIENT_TALK_REQUEST, int)
+CLIENT_VARIABLE(CLIENT_IDLE_TIME, int)
+CLIENT_VARIABLE(CLIENT_IS_MUTED, int)
+CLIENT_VARIABLE(CLIENT_IS_RECORDING, int)
+CLIENT_VARIABLE(CLIENT_DATABASE_ID, uint64)
+CLIENT_VARIABLE(CLIENT_TOTALCONNECTIONS, int)
+CLIENT_VARIABLE(CLIENT_CREATED, int)
+CLIENT_VARIABLE(CLIENT_CHANNEL_GROUP_ID, uint64)
+CLIENT_VARIABLE(CLIENT_TALK_POWER, int)
+CLIENT_VARIABLE(CLIENT_IS_TALKER, int)
+CLIENT_VARIABLE(CLIENT_IS_PRIORITY_SPEAKER, int)
+CLIENT_VARIABLE(CLIENT_UNREAD_MESSAGES, int)
+CLIENT_VARIABLE(CLIENT_IS_CHANNEL_COMMANDER, int)
+
+#undef SERVER_VARIABLE
+#undef CHANNEL_VARIABLE
+#undef CLIENT_VARIABLE
+
+/* Numbers are formatted into the field's value. Strings stay raw, they come from other users and the server and are escaped by render_layout (see *_FIELD). */
+static void format_value(int value, std::string& out) {
+	char text[16];
+	out.assign(text, snprintf(text, sizeof(text), "%d", value));
+}
+
+static void format_value(uint64 value, std::string& out) {
+	char text[24];
+	out.assign(text, snprintf(text, sizeof(text), "%llu", (unsigned long long)value));
+}
+
+/* Where a variable of type T is fetched to. Strings go straight into the field's value, without a temporary. */
+template <typename T> struct field_result {
+	T value;
+	T& target(std::string& out) { return value; }
+	void format(std::string& out) { format_value(value, out); }
+};
+
+template <> struct field_result<std::string> {
+	std::string& target(std::string& out) { return out; }
+	void format(std::string& out) {}
+};
+
+/* "1 GBYTE | 1000 MBYTE | 1000000 KBYTE | 1000000000 BYTE" */
+static std::string byte_breakdown_string(unsigned long long bytes) {
+	std::string result;
+	result += std::to_string(bytes / 1000 / 1000 / 1000);
+	result += " GBYTE | ";
+	result += std::to_string(bytes / 1000 / 1000);
+	result += " MBYTE | ";
+	result += std::to_string(bytes / 1000);
+	result += " KBYTE | ";
+	result += std::to_string(bytes);
+	result += " BYTE";
+	return result;
+}
+
+static void chomp(std::string& value) {
+	while (!value.empty() && value[value.size() - 1] == '\n') value.erase(value.size() - 1);
+}
+
+/* A value that could not be fetched shows as empty, time and byte fields show it as 0 */
+template <size_t flag> void server_field(uint64 serverConnectionHandlerID, uint64 id, std::string& value) {
+	field_result<typename server_variable<flag>::type> result;
+	if (server_value(serverConnectionHandlerID, flag, result.target(value))) result.format(value);
+	else value.clear();
+}
+
+template <size_t flag> void server_time_field(uint64 serverConnectionHandlerID, uint64 id, std::string& value) {
+	typename server_variable<flag>::type result = 0;
+	server_value(serverConnectionHandlerID, flag, result);
+	value = get_time_string((int)result);
+}
+
+template <size_t flag> void server_bytes_field(uint64 serverConnectionHandlerID, uint64 id, std::string& value) {
+	typename server_variable<flag>::type result = 0;
+	server_value(serverConnectionHandlerID, flag, result);
+	value = byte_breakdown_string(result);
+}
+
+template <size_t flag> void channel_field(uint64 serverConnectionHandlerID, uint64 id, std::string& value) {
+	field_result<typename channel_variable<flag>::type> result;
+	if (channel_value(serverConnectionHandlerID, id, flag, result.target(value))) result.format(value);
+	else value.clear();
+}
+
+template <size_t flag> void client_field(uint64 serverConnectionHandlerID, uint64 id, std::string& value) {
+	field_result<typename client_variable<flag>::type> result;
+	if (client_value(serverConnectionHandlerID, (anyID)id, flag, result.target(value))) result.format(value);
+	else value.clear();
+}
+
+template <size_t flag> void client_time_field(uint64 serverConnectionHandlerID, uint64 id, std::string& value) {
+	typename client_variable<flag>::type result = 0;
+	client_value(serverConnectionHandlerID, (anyID)id, flag, result);
+	value = get_time_string((int)result);
+}
+
+static void channel_description_field(uint64 serverConnectionHandlerID, uint64 id, std::string& value) {
+	value = channel_description_string(serverConnectionHandlerID, id);
+	chomp(value);
+}
+
+static void channel_files_field(uint64 serverConnectionHandlerID, uint64 id, std::string& value) {
+	value = channel_storage_string(serverConnectionHandlerID, id);
+	chomp(value);
+}
+
+static void client_badges_field(uint64 serverConnectionHandlerID, uint64 id, std::string& value) {
+	value.clear();
+	std::vector<std::string> arr = split(client_string(serverConnectionHandlerID, (anyID)id, CLIENT_BADGES), ':');
+	if (arr.empty()) return;
+
+	if (arr[0] != "overwolf=0") {
+		value += "[B]Overwolf[/B]";
+	}
+	if (arr.size() > 1) {
+		std::vector<std::string> arr2 = split(arr[1], ',');
+		if (!arr2.empty()) arr2[0] = arr2[0].erase(0, 7);  /* "badges=" */
+		for (std::vector<std::string>::iterator it = arr2.begin(); it != arr2.end(); it++) {
+			value += it != arr2.begin() ? " | [B]" : "[B]";
+			value += guid_name(*it);
+			value += "[/B]";
+		}
+	}
+}
+
+static void client_is_self_field(uint64 serverConnectionHandlerID, uint64 id, std::string& value) {
+	anyID own_id;
+	sdk_variable_calls++;
+	if (ts3Functions.getClientID(serverConnectionHandlerID, &own_id) != ERROR_ok || own_id != (anyID)id) value.clear();
+	else value = "1";
+}
+
+static void client_voice_level_field(uint64 serverConnectionHandlerID, uint64 id, std::string& value) {
+	value = voice_meter_string(serverConnectionHandlerID, (anyID)id);
+}
+
+static void client_microphone_field(uint64 serverConnectionHandlerID, uint64 id, std::string& value) {
+	value = mic_diagnostics_string(serverConnectionHandlerID);
+	chomp(value);
+}
+
+static void client_avatar_field(uint64 serverConnectionHandlerID, uint64 id, std::string& value) {
+	std::string hash;
+	client_value(serverConnectionHandlerID, (anyID)id, CLIENT_FLAG_AVATAR, hash);
+	value = avatar_string(serverConnectionHandlerID, (anyID)id, hash);
+}
+
+static void client_history_field(uint64 serverConnectionHandlerID, uint64 id, std::string& value) {
+	value = client_history_string(serverConnectionHandlerID, (anyID)id);
+	chomp(value);
+}
+
+static void client_shared_history_field(uint64 serverConnectionHandlerID, uint64 id, std::string& value) {
+	value = shared_history_string(serverConnectionHandlerID, (anyID)id);
+}
+
+static void server_changes_field(uint64 serverConnectionHandlerID, uint64 id, std::string& value) {
+	value = change_feed_string(serverConnectionHandlerID, FEED_SERVER, 0);
+	chomp(value);
+}
+
+static void channel_changes_field(uint64 serverConnectionHandlerID, uint64 id, std::string& value) {
+	value = change_feed_string(serverConnectionHandlerID, FEED_CHANNEL, id);
+	chomp(value);
+}
+
+static void client_changes_field(uint64 serverConnectionHandlerID, uint64 id, std::string& value) {
+	value = change_feed_string(serverConnectionHandlerID, FEED_CLIENT, id);
+	chomp(value);
+}
+
+static void client_channel_needed_tp_field(uint64 serverConnectionHandlerID, uint64 id, std::string& value) {
+	uint64 client_channel;
+	sdk_variable_calls++;
+	if (ts3Functions.getChannelOfClient(serverConnectionHandlerID, (anyID)id, &client_channel) != ERROR_ok) value.clear();
+	else channel_field<CHANNEL_NEEDED_TALK_POWER>(serverConnectionHandlerID, client_channel, value);
+}
+
+/* Variable fields. Text variables are marked for render_layout to escape while appending them. */
+#define SERVER_FIELD(name, flag) { name, server_field<flag>, std::is_same<server_variable<flag>::type, std::string>::value }
+#define CHANNEL_FIELD(name, flag) { name, channel_field<flag>, std::is_same<channel_variable<flag>::type, std::string>::value }
+#define CLIENT_FIELD(name, flag) { name, client_field<flag>, std::is_same<client_variable<flag>::type, std::string>::value }
+
+static const layout_field server_fields[] = {
+	SERVER_FIELD("id", VIRTUALSERVER_ID),
+	SERVER_FIELD("unique_identifier", VIRTUALSERVER_UNIQUE_IDENTIFIER),
+	SERVER_FIELD("name", VIRTUALSERVER_NAME),
+	SERVER_FIELD("platform", VIRTUALSERVER_PLATFORM),
+	SERVER_FIELD("version", VIRTUALSERVER_VERSION),
+	SERVER_FIELD("max_clients", VIRTUALSERVER_MAXCLIENTS),
+	SERVER_FIELD("clients_online", VIRTUALSERVER_CLIENTS_ONLINE),
+	{ "created", server_time_field<VIRTUALSERVER_CREATED> },
+	SERVER_FIELD("uptime", VIRTUALSERVER_UPTIME),
+	SERVER_FIELD("codec_encryption_mode", VIRTUALSERVER_CODEC_ENCRYPTION_MODE),
+	SERVER_FIELD("welcome_message", VIRTUALSERVER_WELCOMEMESSAGE),
+	SERVER_FIELD("default_server_group", VIRTUALSERVER_DEFAULT_SERVER_GROUP),
+	SERVER_FIELD("default_channel_group", VIRTUALSERVER_DEFAULT_CHANNEL_GROUP),
+	SERVER_FIELD("default_channel_admin_group", VIRTUALSERVER_DEFAULT_CHANNEL_ADMIN_GROUP),
+	{ "max_upload_total_bandwidth", server_bytes_field<VIRTUALSERVER_MAX_UPLOAD_TOTAL_BANDWIDTH> },
+	{ "max_download_total_bandwidth", server_bytes_field<VIRTUALSERVER_MAX_DOWNLOAD_TOTAL_BANDWIDTH> },
+	SERVER_FIELD("hostbutton_tooltip", VIRTUALSERVER_HOSTBUTTON_TOOLTIP),
+	SERVER_FIELD("hostbutton_url", VIRTUALSERVER_HOSTBUTTON_URL),
+	SERVER_FIELD("hostbutton_gfx_url", VIRTUALSERVER_HOSTBUTTON_GFX_URL),
+	SERVER_FIELD("min_client_version", VIRTUALSERVER_MIN_CLIENT_VERSION),
+	SERVER_FIELD("min_android_version", VIRTUALSERVER_MIN_ANDROID_VERSION),
+	SERVER_FIELD("min_ios_version", VIRTUALSERVER_MIN_IOS_VERSION),
+	SERVER_FIELD("min_winphone_version", VIRTUALSERVER_MIN_WINPHONE_VERSION),
+	SERVER_FIELD("ip", VIRTUALSERVER_IP),
+	SERVER_FIELD("port", VIRTUALSERVER_PORT),
+	SERVER_FIELD("complain_autoban_count", VIRTUALSERVER_COMPLAIN_AUTOBAN_COUNT),
+	SERVER_FIELD("complain_autoban_time", VIRTUALSERVER_COMPLAIN_AUTOBAN_TIME),
+	SERVER_FIELD("complain_remove_time", VIRTUALSERVER_COMPLAIN_REMOVE_TIME),
+	{ "upload_quota", server_bytes_field<VIRTUALSERVER_UPLOAD_QUOTA> },
+	{ "download_quota", server_bytes_field<VIRTUALSERVER_DOWNLOAD_QUOTA> },
+	SERVER_FIELD("antiflood_points_tick_reduce", VIRTUALSERVER_ANTIFLOOD_POINTS_TICK_REDUCE),
+	SERVER_FIELD("antiflood_points_needed_command_block", VIRTUALSERVER_ANTIFLOOD_POINTS_NEEDED_COMMAND_BLOCK),
+	SERVER_FIELD("antiflood_points_needed_ip_block", VIRTUALSERVER_ANTIFLOOD_POINTS_NEEDED_IP_BLOCK),
+	{ "changes", server_changes_field },
+};
+
+static const layout_field channel_fields[] = {
+	CHANNEL_FIELD("name", CHANNEL_NAME),
+	CHANNEL_FIELD("order", CHANNEL_ORDER),
+	CHANNEL_FIELD("delete_delay", CHANNEL_DELETE_DELAY),
+	CHANNEL_FIELD("max_clients", CHANNEL_MAXCLIENTS),
+	CHANNEL_FIELD("needed_talk_power", CHANNEL_NEEDED_TALK_POWER),
+	{ "description", channel_description_field },
+	{ "files", channel_files_field },
+	{ "changes", channel_changes_field },
+};
+
+static const layout_field client_fields[] = {
+	CLIENT_FIELD("nickname", CLIENT_NICKNAME),
+	CLIENT_FIELD("unique_identifier", CLIENT_UNIQUE_IDENTIFIER),
+	CLIENT_FIELD("version", CLIENT_VERSION),
+	CLIENT_FIELD("platform", CLIENT_PLATFORM),
+	CLIENT_FIELD("nickname_phonetic", CLIENT_NICKNAME_PHONETIC),
+	CLIENT_FIELD("country", CLIENT_COUNTRY),
+	{ "badges", client_badges_field },
+	CLIENT_FIELD("input_muted", CLIENT_INPUT_MUTED),
+	CLIENT_FIELD("output_muted", CLIENT_OUTPUT_MUTED),
+	CLIENT_FIELD("input_hardware", CLIENT_INPUT_HARDWARE),
+	CLIENT_FIELD("output_hardware", CLIENT_OUTPUT_HARDWARE),
+	CLIENT_FIELD("away", CLIENT_AWAY),
+	CLIENT_FIELD("away_message", CLIENT_AWAY_MESSAGE),
+	CLIENT_FIELD("talk_request", CLIENT_TALK_REQUEST),
+	CLIENT_FIELD("talk_request_msg", CLIENT_TALK_REQUEST_MSG),
+	CLIENT_FIELD("idle_time", CLIENT_IDLE_TIME),
+	CLIENT_FIELD("is_muted", CLIENT_IS_MUTED),
+	CLIENT_FIELD("is_recording", CLIENT_IS_RECORDING),
+	{ "voice_level", client_voice_level_field },
+	{ "is_self", client_is_self_field },
+	{ "microphone", client_microphone_field },
+	{ "history", client_history_field },
+	{ "shared_history", client_shared_history_field },
+	{ "changes", client_changes_field },
+	CLIENT_FIELD("database_id", CLIENT_DATABASE_ID),
+	CLIENT_FIELD("total_connections", CLIENT_TOTALCONNECTIONS),
+	{ "created", client_time_field<CLIENT_CREATED> },
+	CLIENT_FIELD("servergroups", CLIENT_SERVERGROUPS),
+	CLIENT_FIELD("channel_group_id", CLIENT_CHANNEL_GROUP_ID),
+	CLIENT_FIELD("talk_power", CLIENT_TALK_POWER),
+	{ "channel_needed_talk_power", client_channel_needed_tp_field },
+	CLIENT_FIELD("flag_avatar", CLIENT_FLAG_AVATAR),
+	{ "avatar", client_avatar_field },
+	CLIENT_FIELD("icon_id", CLIENT_ICON_ID),
+	CLIENT_FIELD("is_talker", CLIENT_IS_TALKER),
+	CLIENT_FIELD("is_priority_speaker", CLIENT_IS_PRIORITY_SPEAKER),
+	CLIENT_FIELD("unread_messages", CLIENT_UNREAD_MESSAGES),
+	CLIENT_FIELD("is_channel_commander", CLIENT_IS_CHANNEL_COMMANDER),
+	CLIENT_FIELD("description", CLIENT_DESCRIPTION),
+};
+
+#undef SERVER_FIELD
+#undef CHANNEL_FIELD
+#undef CLIENT_FIELD
+
+/* Indexed by PluginItemType */
+static const layout_fields panel_fields[LAYOUT_PANELS] = {
+	{ server_fields, sizeof(server_fields) / sizeof(server_fields[0]) },
+	{ channel_fields, sizeof(channel_fields) / sizeof(channel_fields[0]) },
+	{ client_fields, sizeof(client_fields) / sizeof(client_fields[0]) },
+};
+
+static const char* default_layout = R"layout({{! Keyinator's More Info layout. Delete this file to get the default back. }}
+[[server]]
+Server-NAME: [B]{{name}}[/B]
+Server-ID: [B]{{id}}[/B]
+Server-UID: [B]{{unique_identifier}}[/B]
+Server-PLATFORM: [B]{{platform}}[/B]
+Server-VERSION: [B]{{version}}[/B]
+Server-CLIENTS: [B]{{clients_online}} / {{max_clients}}[/B]
+Server-CREATED: [B]{{created}}[/B]
+Server-CODEC_ENCRYPTION_MODE: [B]{{codec_encryption_mode}}[/B]
+{{#section welcome_message}}
+Server-WELCOME MESSAGE: [B]UNDERNEATH[/B]
+\/ \/ \/ \/ \/ \/ \/ \/ \/ \/ \/ \/ \/ \/ \/ \/ \/ \/ \/ \/ \/ \/ \/ \/ \/[B]
+{{welcome_message}}
+[/B]/\ /\ /\ /\ /\ /\ /\ /\ /\ /\ /\ /\ /\ /\ /\ /\ /\ /\ /\ /\ /\ /\ /\ /\ /\
+{{/section}}
+
+
+[B][U]EXTENDED[/U][/B]
+
+{{#section default_groups}}
+[B]DEFAULT-GROUPS:[/B]
+DEFAULT_SERVER_GROUP: [B]{{default_server_group}}[/B]
+DEFAULT_CHANNEL_GROUP: [B]{{default_channel_group}}[/B]
+DEFAULT_CHANNEL_ADMIN_GROUP: [B]{{default_channel_admin_group}}[/B]
+
+{{/section}}
+{{#section bandwidth}}
+[B]TOTAL BANDWIDTH:[/B]
+UP: [B]{{max_upload_total_bandwidth}}[/B]
+DOWN: [B]{{max_download_total_bandwidth}}[/B]
+
+{{/section}}
+{{#section hostbutton}}
+[B]HOSTBUTTON:[/B]
+HOSTBUTTON-TOOLTIP: [B]{{hostbutton_tooltip}}[/B]
+HOSTBUTTON-LINK: [B]{{hostbutton_url}}[/B]
+HOSTBUTTON-IMAGE: [B]{{hostbutton_gfx_url}}[/B]
+
+{{/section}}
+{{#section min_versions}}
+[B]MINIMUM REQUIREMENTS:[/B]
+CLIENT: [B]{{min_client_version}}[/B]
+ANDROID: [B]{{min_android_version}}[/B]
+IOS: [B]{{min_ios_version}}[/B]
+WINPHONE: [B]{{min_winphone_version}}[/B]
+
+{{/section}}
+{{#section ip}}
+[B]SERVER-IP:[/B]
+[B]{{ip}}:{{port}}[/B]
+
+{{/section}}
+{{#section complaints}}
+[B]COMPLAINS:[/B]
+COUNT TO BAN: [B]{{complain_autoban_count}}[/B]
+BAN TIME: [B]{{complain_autoban_time}} sec[/B]
+REMOVE COMPLAINS AFTER: [B]{{complain_remove_time}} sec[/B]
+
+{{/section}}
+{{#section quotas}}
+[B]TOTAL BANDWIDTH:[/B]
+UP: [B]{{upload_quota}}[/B]
+DOWN: [B]{{download_quota}}[/B]
+
+{{/section}}
+{{#section antiflood}}
+[B]ANITFLOOD:[/B]
+POINTS REDUCED PER TICK: [B]{{antiflood_points_tick_reduce}}[/B]
+TICKS UNTIL COMMAND BLOCK: [B]{{antiflood_points_needed_command_block}} sec[/B]
+TICKS UNTIL IP BLOCK: [B]{{antiflood_points_needed_ip_block}} sec[/B]
+
+{{/section}}
+{{#section changes}}
+[B]RECENT CHANGES:[/B]
+{{changes}}
+
+{{/section}}
+[[channel]]
+channel-name: [B]{{name}}[/B]
+channel-order: [B]{{order}}[/B]
+channel-delete-delay: [B]{{delete_delay}}[/B]
+channel-max_clients: [B]{{max_clients}}[/B]
+channel-needed_tp: [B]{{needed_talk_power}}[/B]
+{{#section description}}
+
+[B]DESCRIPTION:[/B]
+{{description}}
+{{/section}}
+{{#section files}}
+
+[B]FILES:[/B]
+{{files}}
+{{/section}}
+{{#section changes}}
+
+[B]RECENT CHANGES:[/B]
+{{changes}}
+{{/section}}
+[[client]]
+CLIENT-RELATED:
+------------------------
+name: [B]{{nickname}}[/B]
+uuid: [B]{{unique_identifier}}[/B]
+build: [B]{{version}} on {{platform}}[/B]
+client phonetic name: [B]{{nickname_phonetic}}[/B]
+country of client: [B]{{country}}[/B]
+badges of client: {{badges}}
+
+STATUS:
+has client requested tp: [B]{{talk_request}}[/B]
+client-idle-time: [B]{{idle_time}}[/B]
+client-muted (by you): [B]{{is_muted}}[/B]
+is client recording: [B]{{is_recording}}[/B]
+{{#section voice}}
+average loudness / clipping: [B]{{voice_level}}[/B]
+{{/section}}
+
+{{#if is_self}}
+{{#section microphone}}
+MICROPHONE:
+{{microphone}}
+
+{{/section}}
+{{/if}}
+{{#section history}}
+HISTORY:
+{{history}}
+{{#if shared_history}}
+shared by other users: {{shared_history}}
+{{/if}}
+
+{{/section}}
+{{#section changes}}
+RECENT CHANGES:
+{{changes}}
+
+{{/section}}
+SERVER-RELATED:
+------------------------
+databaseid: [B]{{database_id}}[/B]
+connections to server: [B]{{total_connections}}[/B]
+first connection of client: [B]{{created}}[/B]
+
+GROUPS: [B][/B]
+
+servergroupid(s): [B]{{servergroups}}[/B]
+channelgroupid: [B]{{channel_group_id}}[/B]
+
+PERMS:
+------------------------
+client talkpower: [B]{{talk_power}}[/B] | [B]{{channel_needed_talk_power}}[/B]
+client avatar id: [B]{{flag_avatar}}[/B]
+client avatar: [B]{{avatar}}[/B]
+client icon id: [B]{{icon_id}}[/B]
+client is talker: [B]{{is_talker}}[/B]
+client is priority speaker: [B]{{is_priority_speaker}}[/B]
+unread messages clientside: [B]{{unread_messages}}[/B]
+client channel commander: [B]{{is_channel_commander}}[/B]
+)layout";
+
+static std::string layout_path() {
+	return config_file_path(LAYOUT_FILENAME);
+}
+
+/* Compiles the layout file, writing the default there first if there is none. Returns the problems found, if any. */
+std::string reload_layout() {
+	std::string path = layout_path();
+	std::string source;
+	std::string errors;
+	if (!read_file(path, source)) {
+		source = default_layout;
+		if (!write_file(path, source)) {
+			errors += "could not write " + path + "\n";
+		}
+	}
+	load_layout(source, default_layout, panel_fields, errors);
+	apply_section_settings();
+	return errors;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <string>
+
+#include "utf8_file.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/*
+Minimal read/write file mapping of a fixed size. The file is created or resized as needed.
+*/
+
+struct mapped_file {
+	unsigned char* data;
+	size_t size;
+#ifdef _WIN32
+	HANDLE file;
+	HANDLE mapping;
+#else
+	int fd;
+#endif
+};
+
+bool map_file(const std::string& path, size_t size, mapped_file& out) {
+	out.data = NULL;
+	out.size = 0;
+#ifdef _WIN32
+	out.file = CreateFileW(utf8_to_wide(path.c_str()).c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (out.file == INVALID_HANDLE_VALUE) return false;
+	out.mapping = CreateFileMappingW(out.file, NULL, PAGE_READWRITE, (DWORD)((unsigned long long)size >> 32), (DWORD)(size & 0xFFFFFFFF), NULL);
+	if (!out.mapping) {
+		CloseHandle(out.file);
+		return false;
+	}
+	out.data = (unsigned char*)MapViewOfFile(out.mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+	if (!out.data) {
+		CloseHandle(out.mapping);
+		CloseHandle(out.file);
+		return false;
+	}
+#else
+	out.fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+	if (out.fd < 0) return false;
+	struct stat st;
+	if (fstat(out.fd, &st) != 0 || ((size_t)st.st_size != size && ftruncate(out.fd, (off_t)size) != 0)) {
+		close(out.fd);
+		return false;
+	}
+	void* data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, out.fd, 0);
+	if (data == MAP_FAILED) {
+		close(out.fd);
+		return false;
+	}
+	out.data = (unsigned char*)data;
+#endif
+	out.size = size;
+	return true;
+}
+
+/* Writes dirty pages back to disk before returning */
+void flush_mapped_file(mapped_file& file) {
+	if (!file.data) return;
+#ifdef _WIN32
+	FlushViewOfFile(file.data, file.size);
+	FlushFileBuffers(file.file);
+#else
+	msync(file.data, file.size, MS_SYNC);
+#endif
+}
+
+void unmap_file(mapped_file& file) {
+	if (!file.data) return;
+#ifdef _WIN32
+	UnmapViewOfFile(file.data);
+	CloseHandle(file.mapping);
+	CloseHandle(file.file);
+#else
+	munmap(file.data, file.size);
+	close(file.fd);
+#endif
+	file.data = NULL;
+	file.size = 0;
+}
@@ -0,0 +1,195 @@
+#pragma once
+
+#include <atomic>
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include "voice_meter.h"
+
+/*
+Quality diagnostics of our own capture, measured on the real-time audio thread.
+The captured stream is cut into frames of MIC_FRAME_SAMPLES and the last MIC_WINDOW_FRAMES frames form a rolling window.
+Everything lives in fixed storage, so the capture callback never allocates, locks or logs.
+*/
+
+#define MIC_FRAME_SAMPLES 480     /* 10 ms of mono 48 kHz */
+#define MIC_WINDOW_FRAMES 500     /* 5 s rolling window */
+#define MIC_HISTOGRAM_BUCKETS 97  /* frame level in whole dBFS, -96..0 */
+#define MIC_SILENCE_DBFS -60
+#define MIC_NOISE_FLOOR_PERCENTILE 10
+
+struct mic_frame {
+	uint64_t sum_squares;
+	int64_t sum;
+	uint32_t clipped;
+	uint32_t samples;
+	int bucket;
+};
+
+/* Only ever touched by the capture thread */
+struct mic_window {
+	mic_frame frames[MIC_WINDOW_FRAMES];
+	uint32_t histogram[MIC_HISTOGRAM_BUCKETS];
+	int next;
+	int filled;
+	uint64_t sum_squares;
+	int64_t sum;
+	uint64_t clipped;
+	uint64_t samples;
+	mic_frame partial;
+	int partial_channels;  /* a frame is never made of buffers with different channel counts */
+};
+
+struct mic_diagnostics_reading {
+	uint64 connection;
+	double noise_floor_dbfs;
+	double dc_offset;
+	double clipping_percent;
+	double silence_percent;
+	double rms_dbfs;
+	uint32_t window_frames;
+};
+
+static mic_window mic;
+static std::atomic<uint32_t> mic_seq(0);
+static std::atomic<uint64_t> mic_connection(0);
+static std::atomic<uint64_t> mic_noise_floor_centi(0);
+static std::atomic<int64_t> mic_dc_offset_centi(0);
+static std::atomic<uint64_t> mic_clipping_centi(0);
+static std::atomic<uint64_t> mic_silence_centi(0);
+static std::atomic<int64_t> mic_rms_centi(0);
+static std::atomic<uint32_t> mic_window_frames(0);
+/* A disconnect asks the capture thread to start a new window; readers see no data until it did */
+static std::atomic<uint32_t> mic_reset_requested(0);
+static std::atomic<uint32_t> mic_reset_applied(0);
+
+static int mic_frame_bucket(const mic_frame* f) {
+	if (f->samples == 0 || f->sum_squares == 0) return 0;
+	double rms = sqrt((double)f->sum_squares / (double)f->samples);
+	int db = (int)floor(20.0 * log10(rms / 32768.0));
+	if (db < -96) db = -96;
+	if (db > 0) db = 0;
+	return db + 96;
+}
+
+static void mic_push_frame(mic_frame* f) {
+	f->bucket = mic_frame_bucket(f);
+	if (mic.filled == MIC_WINDOW_FRAMES) {
+		mic_frame* old = &mic.frames[mic.next];
+		mic.sum_squares -= old->sum_squares;
+		mic.sum -= old->sum;
+		mic.clipped -= old->clipped;
+		mic.samples -= old->samples;
+		mic.histogram[old->bucket]--;
+	}
+	else {
+		mic.filled++;
+	}
+	mic.frames[mic.next] = *f;
+	mic.next = (mic.next + 1) % MIC_WINDOW_FRAMES;
+	mic.sum_squares += f->sum_squares;
+	mic.sum += f->sum;
+	mic.clipped += f->clipped;
+	mic.samples += f->samples;
+	mic.histogram[f->bucket]++;
+}
+
+static void mic_publish(uint64 serverConnectionHandlerID) {
+	uint32_t below = 0;
+	uint32_t silent = 0;
+	int floor_bucket = 0;
+	uint32_t wanted = (uint32_t)mic.filled * MIC_NOISE_FLOOR_PERCENTILE / 100;
+	for (int b = 0; b < MIC_HISTOGRAM_BUCKETS; b++) {
+		if (below <= wanted) floor_bucket = b;
+		below += mic.histogram[b];
+		if (b - 96 < MIC_SILENCE_DBFS) silent += mic.histogram[b];
+	}
+	double rms = mic.samples ? sqrt((double)mic.sum_squares / (double)mic.samples) : 0.0;
+	double rms_dbfs = rms > 0.0 ? 20.0 * log10(rms / 32768.0) : -96.0;
+
+	uint32_t seq = mic_seq.load(std::memory_order_relaxed);
+	mic_seq.store(seq + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	mic_connection.store(serverConnectionHandlerID, std::memory_order_relaxed);
+	mic_noise_floor_centi.store((uint64_t)(96 - floor_bucket) * 100, std::memory_order_relaxed);
+	mic_dc_offset_centi.store(mic.samples ? mic.sum * 100 / (int64_t)mic.samples : 0, std::memory_order_relaxed);
+	mic_clipping_centi.store(mic.samples ? mic.clipped * 10000 / mic.samples : 0, std::memory_order_relaxed);
+	mic_silence_centi.store(mic.filled ? (uint64_t)silent * 10000 / mic.filled : 0, std::memory_order_relaxed);
+	mic_rms_centi.store((int64_t)(rms_dbfs * 100.0), std::memory_order_relaxed);
+	mic_window_frames.store((uint32_t)mic.filled, std::memory_order_relaxed);
+	mic_seq.store(seq + 2, std::memory_order_release);
+}
+
+/* Audio thread. Reads the samples only. */
+void diagnose_captured_voice_data(uint64 serverConnectionHandlerID, const short* samples, int sampleCount, int channels) {
+	uint32_t reset = mic_reset_requested.load(std::memory_order_acquire);
+	if (reset != mic_reset_applied.load(std::memory_order_relaxed)) {
+		memset(&mic, 0, sizeof(mic));
+		mic_reset_applied.store(reset, std::memory_order_release);
+	}
+	int total = sampleCount * channels;
+	int frame_samples = MIC_FRAME_SAMPLES * channels;
+	if (channels != mic.partial_channels) {
+		/* e.g. the capture device changed from stereo to mono; the started frame would never fill up exactly */
+		mic.partial = mic_frame();
+		mic.partial_channels = channels;
+	}
+	int i = 0;
+	while (i < total) {
+		int take = frame_samples - (int)mic.partial.samples;
+		if (take > total - i) take = total - i;
+		if (take < 1) take = 1;
+		voice_levels levels;
+		measure_levels(samples + i, take, &levels);
+		mic.partial.sum_squares += levels.sum_squares;
+		mic.partial.sum += levels.sum;
+		mic.partial.clipped += levels.clipped;
+		mic.partial.samples += levels.samples;
+		i += take;
+		if ((int)mic.partial.samples >= frame_samples) {
+			mic_push_frame(&mic.partial);
+			mic.partial = mic_frame();
+		}
+	}
+	mic_publish(serverConnectionHandlerID);
+}
+
+bool read_mic_diagnostics(mic_diagnostics_reading* out) {
+	for (int attempt = 0; attempt < 64; attempt++) {
+		uint32_t before = mic_seq.load(std::memory_order_acquire);
+		if (before & 1) continue;
+		out->connection = mic_connection.load(std::memory_order_relaxed);
+		out->noise_floor_dbfs = -(double)mic_noise_floor_centi.load(std::memory_order_relaxed) / 100.0;
+		out->dc_offset = (double)mic_dc_offset_centi.load(std::memory_order_relaxed) / 100.0;
+		out->clipping_percent = (double)mic_clipping_centi.load(std::memory_order_relaxed) / 100.0;
+		out->silence_percent = (double)mic_silence_centi.load(std::memory_order_relaxed) / 100.0;
+		out->rms_dbfs = (double)mic_rms_centi.load(std::memory_order_relaxed) / 100.0;
+		out->window_frames = mic_window_frames.load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (mic_seq.load(std::memory_order_relaxed) != before) continue;
+		return out->window_frames > 0 && mic_reset_applied.load(std::memory_order_acquire) == mic_reset_requested.load(std::memory_order_acquire);
+	}
+	return false;
+}
+
+/* From close_connection_state. Only the connection last measured has data to drop. */
+void reset_mic_diagnostics(uint64 serverConnectionHandlerID) {
+	if (mic_connection.load(std::memory_order_relaxed) == serverConnectionHandlerID) mic_reset_requested++;
+}
+
+std::string mic_diagnostics_string(uint64 serverConnectionHandlerID) {
+	mic_diagnostics_reading r;
+	if (!read_mic_diagnostics(&r) || r.connection != serverConnectionHandlerID) {
+		return "no capture data yet\n";
+	}
+	char buffer[256];
+	snprintf(buffer, sizeof(buffer),
+		"noise floor: [B]%.0f dBFS[/B]\n"
+		"average level: [B]%.1f dBFS[/B]\n"
+		"dc offset: [B]%.2f[/B]\n"
+		"clipping: [B]%.2f %%[/B]\n"
+		"silence: [B]%.1f %%[/B] (last %.1f sec)\n",
+		r.noise_floor_dbfs, r.rms_dbfs, r.dc_offset, r.clipping_percent, r.silence_percent, r.window_frames * 0.01);
+	return buffer;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <mutex>
+#include <set>
+
+/*
+Connections between STATUS_CONNECTION_ESTABLISHED and the disconnect (see connection_state.h). Feature modules check
+connection_open under their own mutex before they create state for a connection, so renders of a tab that is still
+connecting and events that arrive after the close leave nothing behind: the close marks the connection closed before
+it drops the modules' state.
+*/
+
+static std::set<uint64> open_connections;
+static std::mutex open_connections_mutex;
+
+static bool connection_open(uint64 serverConnectionHandlerID) {
+	std::lock_guard<std::mutex> lock(open_connections_mutex);
+	return open_connections.count(serverConnectionHandlerID) != 0;
+}
+
+static void set_connection_open(uint64 serverConnectionHandlerID, bool open) {
+	std::lock_guard<std::mutex> lock(open_connections_mutex);
+	if (open) open_connections.insert(serverConnectionHandlerID);
+	else open_connections.erase(serverConnectionHandlerID);
+}
@@ -21,7 +21,7 @@
 #include "ts3_functions.h"
 #include "plugin.h"
 #include <string>
-#include "functions.h"
+#include "Functions.h"
 #include "badge_ids.h"
 
 static struct TS3Functions ts3Functions;
@@ -44,6 +44,39 @@ static struct TS3Functions ts3Functions;
 
 static char* pluginID = NULL;
 
+/*
+Threading model:
+ - ts3Functions and pluginID are written before ts3plugin_init and only read afterwards. pluginID is freed in
+   ts3plugin_shutdown after the plugin's own threads were stopped.
+ - Callbacks, infoData and processCommand may run on different client threads, audio callbacks on the audio thread.
+ - Read-mostly state (compiled layouts, badge names) is built aside and published as an immutable snapshot with
+   std::atomic_store; readers take it with std::atomic_load and never lock.
+ - Single values are atomics, audio thread results are published with a sequence lock (see voice_meter.h).
+ - Everything else is owned by its module and guarded by that module's mutex. No mutex is held while calling into
+   the client, except for the plain variable getters.
+ - The plugin's own threads (client history, export, settings watcher) are stopped in ts3plugin_shutdown.
+*/
+
+/* Feature modules, included here since they use ts3Functions and pluginID */
+#include "open_connections.h"
+#include "voice_meter.h"
+#include "bbcode.h"
+#include "buffer_pool.h"
+#include "mic_diagnostics.h"
+#include "file_storage.h"
+#include "channel_description.h"
+#include "avatar_info.h"
+#include "layout.h"
+#include "settings.h"
+#include "client_history.h"
+#include "string_table.h"
+#include "change_feed.h"
+#include "info_exchange.h"
+#include "layout_fields.h"
+#include "server_snapshot.h"
+#include "client_export.h"
+#include "connection_state.h"
+
 #ifdef _WIN32
 /* Helper function to convert wchar_T to Utf-8 encoded strings on Windows */
 static int wcharToUtf8(const wchar_t* str, char** result) {
@@ -119,6 +152,7 @@ int ts3plugin_init() {
     /* Your plugin init code here */
     printf("PLUGIN: init\n");
 	init_guids();
+	init_voice_meter();
 
     /* Example on how to query application, resources and configuration paths from client */
     /* Note: Console client returns empty string for app and resources path */
@@ -129,6 +163,15 @@ int ts3plugin_init() {
 
 	printf("PLUGIN: App path: %s\nResources path: %s\nConfig path: %s\nPlugin path: %s\n", appPath, resourcesPath, configPath, pluginPath);
 
+	load_settings();
+	std::string layout_errors = reload_layout();
+	if (!layout_errors.empty()) {
+		printf("PLUGIN: layout: %s", layout_errors.c_str());
+	}
+	open_snapshot_store();
+	start_client_history();
+	open_established_connections();
+
     return 0;  /* 0 = success, 1 = failure, -2 = failure but client will not show a "failed to load" warning */
 	/* -2 is a very special case and should only be used if a plugin displays a dialog (e.g. overlay) asking the user to disable
 	 * the plugin again, avoiding the show another dialog by the client telling the user the plugin failed to load.
@@ -139,6 +182,15 @@ int ts3plugin_init() {
 void ts3plugin_shutdown() {
     /* Your plugin cleanup code here */
     printf("PLUGIN: shutdown\n");
+#ifdef KMI_METER_TIMING
+	printf("PLUGIN: voice meter: %s\n", voice_meter_cost_string().c_str());
+#endif
+	stop_settings_editor();
+	cancel_client_export(true);
+	stop_client_history();
+	close_snapshot_store();
+	release_buffer_pool();
+	release_layout_values();
 
 	/*
 	 * Note:
@@ -167,12 +219,13 @@ int ts3plugin_offersConfigure() {
 	 * PLUGIN_OFFERS_CONFIGURE_NEW_THREAD - Plugin does implement ts3plugin_configure and requests to run this function in an own thread
 	 * PLUGIN_OFFERS_CONFIGURE_QT_THREAD  - Plugin does implement ts3plugin_configure and requests to run this function in the Qt GUI thread
 	 */
-	return PLUGIN_OFFERS_NO_CONFIGURE;  /* In this case ts3plugin_configure does not need to be implemented */
+	return PLUGIN_OFFERS_CONFIGURE_NEW_THREAD;  /* Replacing a running settings watcher waits for it, keep that off the Qt GUI thread */
 }
 
 /* Plugin might offer a configuration window. If ts3plugin_offersConfigure returns 0, this function does not need to be implemented. */
 void ts3plugin_configure(void* handle, void* qParentWidget) {
     printf("PLUGIN: configure\n");
+	edit_settings();
 }
 
 /*
@@ -187,6 +240,84 @@ void ts3plugin_registerPluginID(const char* id) {
 	printf("PLUGIN: registerPluginID: %s\n", pluginID);
 }
 
+/* Plugin command keyword. Return NULL or "" if not used. */
+const char* ts3plugin_commandKeyword() {
+	return "kmi";
+}
+
+/* Plugin processes console command. Return 0 if plugin handled the command, 1 if not handled. */
+int ts3plugin_processCommand(uint64 serverConnectionHandlerID, const char* command) {
+	std::vector<std::string> args = split(command, ' ');
+	if (args.empty()) {
+		return 1;
+	}
+
+	if (args[0] == "reload") {
+		std::string errors = reload_layout();
+		ts3Functions.printMessageToCurrentTab(errors.empty() ? "Keyinator's More Info: layout reloaded" : ("Keyinator's More Info: layout reloaded with problems:\n" + errors).c_str());
+		return 0;
+	}
+	if (args[0] == "sections") {
+		ts3Functions.printMessageToCurrentTab(("Keyinator's More Info sections:\n" + sections_string()).c_str());
+		return 0;
+	}
+	if (args[0] == "section" && args.size() == 3 && (args[2] == "on" || args[2] == "off")) {
+		if (!set_section_enabled(args[1], args[2] == "on")) {
+			ts3Functions.printMessageToCurrentTab(("Keyinator's More Info: no section named " + args[1]).c_str());
+		}
+		return 0;
+	}
+	if (args[0] == "export" && args.size() <= 2) {
+		std::string format = args.size() == 2 ? args[1] : "csv";
+		if (format == "cancel") {
+			cancel_client_export(false);
+		}
+		else if (format != "json" && format != "csv") {
+			ts3Functions.printMessageToCurrentTab("Keyinator's More Info: usage /kmi export [json|csv|cancel]");
+		}
+		else {
+			std::string error = start_client_export(serverConnectionHandlerID, format == "json");
+			if (!error.empty()) ts3Functions.printMessageToCurrentTab(("Keyinator's More Info: " + error).c_str());
+		}
+		return 0;
+	}
+	if (args[0] == "exchange" && args.size() <= 2) {
+		std::string mode = args.size() == 2 ? args[1] : "";
+		if (mode == "on" || mode == "off") {
+			exchange_enabled.store(mode == "on");
+			save_settings();
+			ts3Functions.printMessageToCurrentTab(mode == "on" ? "Keyinator's More Info: history exchange on" : "Keyinator's More Info: history exchange off");
+		}
+		else if (mode == "loopback") {
+			ts3Functions.printMessageToCurrentTab(("Keyinator's More Info: " + exchange_loopback()).c_str());
+		}
+		else if (!mode.empty()) {
+			ts3Functions.printMessageToCurrentTab("Keyinator's More Info: usage /kmi exchange [on|off|loopback]");
+		}
+		else if (!exchange_enabled.load()) {
+			ts3Functions.printMessageToCurrentTab("Keyinator's More Info: history exchange is off, /kmi exchange on");
+		}
+		else if (!request_shared_history(serverConnectionHandlerID)) {
+			ts3Functions.printMessageToCurrentTab("Keyinator's More Info: no request sent, the last one was less than a minute ago or every visible client was answered for");
+		}
+		return 0;
+	}
+	if (args[0] == "stats") {
+		std::string stats = "Keyinator's More Info stats:\n";
+		stats += "SDK variable calls of the last render: server " + std::to_string(last_render_sdk_calls[PLUGIN_SERVER].load());
+		stats += ", channel " + std::to_string(last_render_sdk_calls[PLUGIN_CHANNEL].load());
+		stats += ", client " + std::to_string(last_render_sdk_calls[PLUGIN_CLIENT].load()) + "\n";
+		stats += "voice meter: " + voice_meter_cost_string() + "\n";
+		stats += "client history: " + client_history_stats_string() + "\n";
+		stats += "history exchange: " + exchange_stats_string() + "\n";
+		stats += connection_stats_string();
+		stats += "info buffers: " + buffer_pool_stats_string();
+		ts3Functions.printMessageToCurrentTab(stats.c_str());
+		return 0;
+	}
+	return 1;  /* Plugin did not handle command */
+}
+
 /*
  * Implement the following three functions when the plugin should display a line in the server/channel/client info.
  * If any of ts3plugin_infoTitle, ts3plugin_infoData or ts3plugin_freeMemory is missing, the info text will not be displayed.
@@ -205,636 +336,43 @@ const char* ts3plugin_infoTitle() {
  */
 void ts3plugin_infoData(uint64 serverConnectionHandlerID, uint64 id, enum PluginItemType type, char** data) {
 
-	/* For demonstration purpose, display the name of the currently selected server, channel or client. */
-
-#pragma warning( push )
-#pragma warning( disable : 4129)
+	/* The panel text comes from the compiled layout, see layout.h and layout_fields.h */
 
-	std::string infodata;
-	bool fail = false;
 	switch(type) {
 		case PLUGIN_SERVER:
-
 			ts3Functions.requestServerVariables(serverConnectionHandlerID);
-
-			char* server_id;
-			char* server_uid;
-			char* server_name;
-			char* server_wm;
-			char* server_platform;
-			char* server_version;
-			char* server_mc;
-			char* server_co;
-			char* server_created;
-			char* server_uptime;
-			char* server_cem;
-
-			ts3Functions.getServerVariableAsString(serverConnectionHandlerID, VIRTUALSERVER_ID, &server_id);
-			ts3Functions.getServerVariableAsString(serverConnectionHandlerID, VIRTUALSERVER_UNIQUE_IDENTIFIER, &server_uid);
-			ts3Functions.getServerVariableAsString(serverConnectionHandlerID, VIRTUALSERVER_NAME, &server_name);
-			ts3Functions.getServerVariableAsString(serverConnectionHandlerID, VIRTUALSERVER_PLATFORM, &server_platform);
-			ts3Functions.getServerVariableAsString(serverConnectionHandlerID, VIRTUALSERVER_VERSION, &server_version);
-			ts3Functions.getServerVariableAsString(serverConnectionHandlerID, VIRTUALSERVER_MAXCLIENTS, &server_mc);
-			ts3Functions.getServerVariableAsString(serverConnectionHandlerID, VIRTUALSERVER_CLIENTS_ONLINE, &server_co);
-			ts3Functions.getServerVariableAsString(serverConnectionHandlerID, VIRTUALSERVER_CREATED, &server_created);
-			ts3Functions.getServerVariableAsString(serverConnectionHandlerID, VIRTUALSERVER_UPTIME, &server_uptime);
-			ts3Functions.getServerVariableAsString(serverConnectionHandlerID, VIRTUALSERVER_CODEC_ENCRYPTION_MODE, &server_cem);
-			ts3Functions.getServerVariableAsString(serverConnectionHandlerID, VIRTUALSERVER_WELCOMEMESSAGE, &server_wm);
-
-			infodata += "Server-NAME: [B]";
-			infodata += server_name;
-			infodata += "[/B]\n";
-			infodata += "Server-ID: [B]";
-			infodata += server_id;
-			infodata += "[/B]\n";
-			infodata += "Server-UID: [B]";
-			infodata += server_uid;
-			infodata += "[/B]\n";
-			infodata += "Server-PLATFORM: [B]";
-			infodata += server_platform;
-			infodata += "[/B]\n";
-			infodata += "Server-VERSION: [B]";
-			infodata += server_version;
-			infodata += "[/B]\n";
-			infodata += "Server-CLIENTS: [B]";
-			infodata += server_co;
-			infodata += " / ";
-			infodata += server_mc;
-			infodata += "[/B]\n";
-			infodata += "Server-CREATED: [B]";
-			infodata += get_time_string(atoi(server_created));
-			infodata += "[/B]\n";
-			infodata += "Server-CODEC_ENCRYPTION_MODE: [B]";
-			infodata += server_cem;
-			infodata += "[/B]\n";
-			infodata += "Server-WELCOME MESSAGE: [B]UNDERNEATH[/B]\n";
-			infodata += "\\/ \\/ \\/ \\/ \\/ \\/ \\/ \\/ \\/ \\/ \\/ \\/ \\/ \\/ \\/ \\/ \\/ \\/ \\/ \\/ \\/ \\/ \\/ \\/ \\/[B]\n";
-			infodata += server_wm;
-			infodata += "\n[/B]/\\ /\\ /\\ /\\ /\\ /\\ /\\ /\\ /\\ /\\ /\\ /\\ /\\ /\\ /\\ /\\ /\\ /\\ /\\ /\\ /\\ /\\ /\\ /\\ /\\";
-			infodata += "\n\n\n[B][U]EXTENDED[/U][/B]\n\n";
-
-			//---------------------------------------------------------------------------
-
-			char* server_d_sg;
-			char* server_d_cg;
-			char* server_d_cag;
-
-			ts3Functions.getServerVariableAsString(serverConnectionHandlerID, VIRTUALSERVER_DEFAULT_SERVER_GROUP, &server_d_sg);
-			ts3Functions.getServerVariableAsString(serverConnectionHandlerID, VIRTUALSERVER_DEFAULT_CHANNEL_GROUP, &server_d_cg);
-			ts3Functions.getServerVariableAsString(serverConnectionHandlerID, VIRTUALSERVER_DEFAULT_CHANNEL_ADMIN_GROUP, &server_d_cag);
-
-			infodata += "[B]DEFAULT-GROUPS:[/B]\n";
-			infodata += "DEFAULT_SERVER_GROUP: [B]";
-			infodata += server_d_sg;
-			infodata += "[/B]\n";
-			infodata += "DEFAULT_CHANNEL_GROUP: [B]";
-			infodata += server_d_cg;
-			infodata += "[/B]\n";
-			infodata += "DEFAULT_CHANNEL_ADMIN_GROUP: [B]";
-			infodata += server_d_cag;
-			infodata += "[/B]\n\n";
-
-			char* server_bw_up;
-			char* server_bw_down;
-			
-			ts3Functions.getServerVariableAsString(serverConnectionHandlerID, VIRTUALSERVER_MAX_UPLOAD_TOTAL_BANDWIDTH, &server_bw_up);
-			ts3Functions.getServerVariableAsString(serverConnectionHandlerID, VIRTUALSERVER_MAX_DOWNLOAD_TOTAL_BANDWIDTH, &server_bw_down);
-
-			infodata += "[B]TOTAL BANDWIDTH:[/B]\n";
-			infodata += "UP: [B]";
-			infodata += std::to_string(atoi(server_bw_up) / 1000 / 1000 / 1000);
-			infodata += " GBYTE | ";
-			infodata += std::to_string(atoi(server_bw_up) / 1000 / 1000);
-			infodata += " MBYTE | ";
-			infodata += std::to_string(atoi(server_bw_up) / 1000);
-			infodata += " KBYTE | ";
-			infodata += std::to_string(atoi(server_bw_up));
-			infodata += " BYTE[/B]\n";
-			infodata += "DOWN: [B]";
-			infodata += std::to_string(atoi(server_bw_down) / 1000 / 1000 / 1000);
-			infodata += " GBYTE | ";
-			infodata += std::to_string(atoi(server_bw_down) / 1000 / 1000);
-			infodata += " MBYTE | ";
-			infodata += std::to_string(atoi(server_bw_down) / 1000);
-			infodata += " KBYTE | ";
-			infodata += std::to_string(atoi(server_bw_down));
-			infodata += " BYTE[/B]\n\n";
-
-
-		/* CRASHES CLIENT
-			char* hostbanner_url;
-			char* hostbanner_gfx_url;
-			char* hostbanner_gfx_interval;
-
-			ts3Functions.getServerVariableAsString(serverConnectionHandlerID, VIRTUALSERVER_HOSTBANNER_URL, &hostbanner_url);
-			ts3Functions.getServerVariableAsString(serverConnectionHandlerID, VIRTUALSERVER_HOSTBANNER_GFX_URL, &hostbanner_gfx_url);
-			ts3Functions.getServerVariableAsString(serverConnectionHandlerID, VIRTUALSERVER_HOSTBANNER_GFX_INTERVAL, &hostbanner_gfx_interval);
-
-			infodata += "[B]HOSTBANNER:[/B]\n";
-			infodata += "HOSTBANNER-LINK: [B]";
-			infodata += hostbanner_url;
-			infodata += "[/B]\n";
-			infodata += "HOSTBANNER-PICTURE: [B]";
-			infodata += hostbanner_gfx_url;
-			infodata += "[/B]\n";
-			infodata += "HOSTBANNER-UPDATE-INTERVAL: [B]";
-			infodata += hostbanner_gfx_interval;
-			infodata += "[/B]\n\n";
-
-		*/
-
-			char* hostbutton_url;
-			char* hostbutton_gfx_url;
-			char* hostbutton_gfx_interval;
-
-			ts3Functions.getServerVariableAsString(serverConnectionHandlerID, VIRTUALSERVER_HOSTBUTTON_TOOLTIP, &hostbutton_url);
-			ts3Functions.getServerVariableAsString(serverConnectionHandlerID, VIRTUALSERVER_HOSTBUTTON_URL, &hostbutton_gfx_url);
-			ts3Functions.getServerVariableAsString(serverConnectionHandlerID, VIRTUALSERVER_HOSTBUTTON_GFX_URL, &hostbutton_gfx_interval);
-
-			infodata += "[B]HOSTBUTTON:[/B]\n";
-			infodata += "HOSTBUTTON-TOOLTIP: [B]";
-			infodata += hostbutton_url;
-			infodata += "[/B]\n";
-			infodata += "HOSTBUTTON-LINK: [B]";
-			infodata += hostbutton_gfx_url;
-			infodata += "[/B]\n";
-			infodata += "HOSTBUTTON-IMAGE: [B]";
-			infodata += hostbutton_gfx_interval;
-			infodata += "[/B]\n\n";
-
-			
-
-			char* vs_min_client;
-			char* vs_min_android;
-			char* vs_min_ios;
-			char* vs_min_winphone;
-
-			ts3Functions.getServerVariableAsString(serverConnectionHandlerID, VIRTUALSERVER_MIN_CLIENT_VERSION, &vs_min_client);
-			ts3Functions.getServerVariableAsString(serverConnectionHandlerID, VIRTUALSERVER_MIN_ANDROID_VERSION, &vs_min_android);
-			ts3Functions.getServerVariableAsString(serverConnectionHandlerID, VIRTUALSERVER_MIN_IOS_VERSION, &vs_min_ios);
-			ts3Functions.getServerVariableAsString(serverConnectionHandlerID, VIRTUALSERVER_MIN_WINPHONE_VERSION, &vs_min_winphone);
-
-			infodata += "[B]MINIMUM REQUIREMENTS:[/B]\n";
-			infodata += "CLIENT: [B]";
-			infodata += vs_min_client;
-			infodata += "[/B]\n";
-			infodata += "ANDROID: [B]";
-			infodata += vs_min_android;
-			infodata += "[/B]\n";
-			infodata += "IOS: [B]";
-			infodata += vs_min_ios;
-			infodata += "[/B]\n";
-			infodata += "WINPHONE: [B]";
-			infodata += vs_min_winphone;
-			infodata += "[/B]\n\n";
-		
-			char* ip;
-			char* ip_port;
-
-			ts3Functions.getServerVariableAsString(serverConnectionHandlerID, VIRTUALSERVER_IP, &ip);
-			ts3Functions.getServerVariableAsString(serverConnectionHandlerID, VIRTUALSERVER_PORT, &ip_port);
-
-			infodata += "[B]SERVER-IP:[/B]\n[B]";
-			infodata += ip;
-			infodata += ":";
-			infodata += ip_port;
-			infodata += "[/B]\n\n";
-
-			char* complain_ab_count;
-			char* complain_ab_time;
-			char* complain_ab_rm_time;
-
-			ts3Functions.getServerVariableAsString(serverConnectionHandlerID, VIRTUALSERVER_COMPLAIN_AUTOBAN_COUNT, &complain_ab_count);
-			ts3Functions.getServerVariableAsString(serverConnectionHandlerID, VIRTUALSERVER_COMPLAIN_AUTOBAN_TIME, &complain_ab_time);
-			ts3Functions.getServerVariableAsString(serverConnectionHandlerID, VIRTUALSERVER_COMPLAIN_REMOVE_TIME, &complain_ab_rm_time);
-
-			infodata += "[B]COMPLAINS:[/B]\n";
-			infodata += "COUNT TO BAN: [B]";
-			infodata += complain_ab_count;
-			infodata += "[/B]\n";
-			infodata += "BAN TIME: [B]";
-			infodata += complain_ab_time;
-			infodata += " sec[/B]\n";
-			infodata += "REMOVE COMPLAINS AFTER: [B]";
-			infodata += complain_ab_rm_time;
-			infodata += " sec[/B]\n\n";
-
-			char* server_quota_up;
-			char* server_quota_down;
-
-			ts3Functions.getServerVariableAsString(serverConnectionHandlerID, VIRTUALSERVER_UPLOAD_QUOTA, &server_quota_up);
-			ts3Functions.getServerVariableAsString(serverConnectionHandlerID, VIRTUALSERVER_DOWNLOAD_QUOTA, &server_quota_down);
-
-			infodata += "[B]TOTAL BANDWIDTH:[/B]\n";
-			infodata += "UP: [B]";
-			infodata += std::to_string(atoi(server_quota_up) / 1000 / 1000 / 1000);
-			infodata += " GBYTE | ";
-			infodata += std::to_string(atoi(server_quota_up) / 1000 / 1000);
-			infodata += " MBYTE | ";
-			infodata += std::to_string(atoi(server_quota_up) / 1000);
-			infodata += " KBYTE | ";
-			infodata += std::to_string(atoi(server_quota_up));
-			infodata += " BYTE[/B]\n";
-			infodata += "DOWN: [B]";
-			infodata += std::to_string(atoi(server_quota_down) / 1000 / 1000 / 1000);
-			infodata += " GBYTE | ";
-			infodata += std::to_string(atoi(server_quota_down) / 1000 / 1000);
-			infodata += " MBYTE | ";
-			infodata += std::to_string(atoi(server_quota_down) / 1000);
-			infodata += " KBYTE | ";
-			infodata += std::to_string(atoi(server_quota_down));
-			infodata += " BYTE[/B]\n\n";
-
-
-			char* complain_af_reduce;
-			char* complain_af_cmd_block;
-			char* complain_af_ip_block;
-
-			ts3Functions.getServerVariableAsString(serverConnectionHandlerID, VIRTUALSERVER_ANTIFLOOD_POINTS_TICK_REDUCE, &complain_af_reduce);
-			ts3Functions.getServerVariableAsString(serverConnectionHandlerID, VIRTUALSERVER_ANTIFLOOD_POINTS_NEEDED_COMMAND_BLOCK, &complain_af_cmd_block);
-			ts3Functions.getServerVariableAsString(serverConnectionHandlerID, VIRTUALSERVER_ANTIFLOOD_POINTS_NEEDED_IP_BLOCK, &complain_af_ip_block);
-
-			infodata += "[B]ANITFLOOD:[/B]\n";
-			infodata += "POINTS REDUCED PER TICK: [B]";
-			infodata += complain_af_reduce;
-			infodata += "[/B]\n";
-			infodata += "TICKS UNTIL COMMAND BLOCK: [B]";
-			infodata += complain_af_cmd_block;
-			infodata += " sec[/B]\n";
-			infodata += "TICKS UNTIL IP BLOCK: [B]";
-			infodata += complain_af_ip_block;
-			infodata += " sec[/B]\n\n";
-			
-			
-			/*
-			infodata += "DEFAULT_CHANNEL_GROUP: [B]";
-			infodata += server_uid;
-			infodata += "[/B]\n";
-			infodata += "DEFAULT_CHANNEL_GROUP: [B]";
-			infodata += server_uid;
-			infodata += "[/B]\n";
-			*/
-
-
-
-			/*
-			VIRTUALSERVER_HOSTMESSAGE_MODE
-				VIRTUALSERVER_FLAG_PASSWORD
-				VIRTUALSERVER_MIN_CLIENTS_IN_CHANNEL_BEFORE_FORCED_SILENCE
-				VIRTUALSERVER_PRIORITY_SPEAKER_DIMM_MODIFICATOR
-				VIRTUALSERVER_IDK
-				VIRTUALSERVER_CLIENT_CONNECTIONS
-				VIRTUALSERVER_QUERY_CLIENT_CONNECTIONS
-
-				VIRTUALSERVER_QUERYCLIENTS_ONLINE
-				VIRTUALSERVER_DOWNLOAD_QUOTA
-				VIRTUALSERVER_UPLOAD_QUOTA
-				VIRTUALSERVER_MONTH_BYTES_DOWNLOADED
-				VIRTUALSERVER_MONTH_BYTES_UPLOADED,
-				VIRTUALSERVER_TOTAL_BYTES_DOWNLOADED
-				VIRTUALSERVER_TOTAL_BYTES_UPLOADED
-				VIRTUALSERVER_AUTOSTART
-				VIRTUALSERVER_MACHINE_ID
-				VIRTUALSERVER_NEEDED_IDENTITY_SECURITY_LEVEL
-				VIRTUALSERVER_NAME_PHONETIC
-				VIRTUALSERVER_ICON_ID
-				VIRTUALSERVER_RESERVED_SLOTS
-				VIRTUALSERVER_TOTAL_PING
-				VIRTUALSERVER_WEBLIST_ENABLED
-				VIRTUALSERVER_ASK_FOR_PRIVILEGEKEY
-				VIRTUALSERVER_HOSTBANNER_MODE
-				VIRTUALSERVER_CHANNEL_TEMP_DELETE_DELAY_DEFAULT
-				*/
-
-			//snprintf(*data, INFODATA_BUFSIZE, "Server-UID: [B]\%s\[/B]", server_uid);  /* bbCode is supported. HTML is not supported */
-
 			break;
-
 		case PLUGIN_CHANNEL:
-
-			char* channel_name;
-			char* channel_order;
-			char* channel_delete_delay;
-			char* channel_max_clients;
-
-			ts3Functions.getChannelVariableAsString(serverConnectionHandlerID, id, CHANNEL_NAME, &channel_name);
-			ts3Functions.getChannelVariableAsString(serverConnectionHandlerID, id, CHANNEL_ORDER, &channel_order);
-			ts3Functions.getChannelVariableAsString(serverConnectionHandlerID, id, CHANNEL_DELETE_DELAY, &channel_delete_delay);
-			ts3Functions.getChannelVariableAsString(serverConnectionHandlerID, id, CHANNEL_MAXCLIENTS, &channel_max_clients);
-
-			infodata += "channel-name: [B]";
-			infodata += channel_name;
-			infodata += "[/B]\n";
-			infodata += "channel-order: [B]";
-			infodata += channel_order;
-			infodata += "[/B]\n";
-			infodata += "channel-delete-delay: [B]";
-			infodata += channel_delete_delay;
-			infodata += "[/B]\n";
-			infodata += "channel-max_clients: [B]";
-			infodata += channel_max_clients;
-			infodata += "[/B]\n";
-			infodata += "channel-needed_tp: [B]";
-			{
-			char* channel_needed_tp;
-			ts3Functions.getChannelVariableAsString(serverConnectionHandlerID, id, CHANNEL_NEEDED_TALK_POWER, &channel_needed_tp);
-			infodata += channel_needed_tp;
-			}
-			infodata += "[/B]\n";
-			
-			//snprintf(*data, INFODATA_BUFSIZE, "Channel-NAME: [B]\%s\[/B]\n\Channel-ORDER: [B]\%s\[/B]\n\Channel-DELETE-DELAY: [B]\%s\[/B]", channel_name, channel_order, channel_delete_delay);  /* bbCode is supported. HTML is not supported */
-
 			break;
-
 		case PLUGIN_CLIENT:
-
 			ts3Functions.requestServerVariables(serverConnectionHandlerID);
 			ts3Functions.requestClientVariables(serverConnectionHandlerID, (anyID)id, NULL);
-
-			char* client_name;
-			char* client_uid;
-			char* client_version;
-
-			ts3Functions.getClientVariableAsString(serverConnectionHandlerID, (anyID)id, CLIENT_NICKNAME, &client_name);
-			ts3Functions.getClientVariableAsString(serverConnectionHandlerID, (anyID)id, CLIENT_UNIQUE_IDENTIFIER, &client_uid);
-			ts3Functions.getClientVariableAsString(serverConnectionHandlerID, (anyID)id, CLIENT_VERSION, &client_version);
-
-			
-
-		//v1.3 CHANGES
-
-			char* client_platform;
-			// Not working char* client_talking;
-			char* client_input_muted;
-			char* client_output_muted;
-			// Not working char* client_outputonly_muted;
-			char* client_input_hw;
-			char* client_output_hw;
-
-			ts3Functions.getClientVariableAsString(serverConnectionHandlerID, (anyID)id, CLIENT_PLATFORM, &client_platform);
-			//ts3Functions.getClientVariableAsString(serverConnectionHandlerID, (anyID)id, CLIENT_FLAG_TALKING, &client_talking);
-			ts3Functions.getClientVariableAsString(serverConnectionHandlerID, (anyID)id, CLIENT_INPUT_MUTED, &client_input_muted);
-			ts3Functions.getClientVariableAsString(serverConnectionHandlerID, (anyID)id, CLIENT_OUTPUT_MUTED, &client_output_muted);
-			//ts3Functions.getClientVariableAsString(serverConnectionHandlerID, (anyID)id, CLIENT_OUTPUTONLY_MUTED, &client_outputonly_muted);
-			ts3Functions.getClientVariableAsString(serverConnectionHandlerID, (anyID)id, CLIENT_INPUT_HARDWARE, &client_input_hw);
-			ts3Functions.getClientVariableAsString(serverConnectionHandlerID, (anyID)id, CLIENT_OUTPUT_HARDWARE, &client_output_hw);
-
-			;
-
-			char* client_idle;
-			char* client_muted;
-			char* client_recording;
-
-			ts3Functions.getClientVariableAsString(serverConnectionHandlerID, (anyID)id, CLIENT_IDLE_TIME, &client_idle);
-			ts3Functions.getClientVariableAsString(serverConnectionHandlerID, (anyID)id, CLIENT_IS_MUTED, &client_muted);
-			ts3Functions.getClientVariableAsString(serverConnectionHandlerID, (anyID)id, CLIENT_IS_RECORDING, &client_recording);
-
-			
-
-			char* client_dbid;
-			char* client_channel_group_id;
-			char* client_server_groups;
-			char* client_created;
-
-			ts3Functions.getClientVariableAsString(serverConnectionHandlerID, (anyID)id, CLIENT_DATABASE_ID, &client_dbid);
-			ts3Functions.getClientVariableAsString(serverConnectionHandlerID, (anyID)id, CLIENT_CHANNEL_GROUP_ID, &client_channel_group_id);
-			ts3Functions.getClientVariableAsString(serverConnectionHandlerID, (anyID)id, CLIENT_SERVERGROUPS, &client_server_groups);
-			ts3Functions.getClientVariableAsString(serverConnectionHandlerID, (anyID)id, CLIENT_CREATED, &client_created);
-
-			
-
-			char* client_connections;
-			char* client_away;
-			char* client_away_message;
-			char* client_avatar;
-			char* client_tp;
-			char* client_talk_request;
-			char* client_talk_request_msg;
-			char* client_description;
-			char* client_talker;
-			char* client_priority_speaker;
-			char* client_unread_messages;
-			char* client_phonetic_nickname;
-			char* client_icon_id;
-			char* client_channel_commander;
-			char* client_country;
-			char* client_badges;
-
-			ts3Functions.getClientVariableAsString(serverConnectionHandlerID, (anyID)id, CLIENT_TOTALCONNECTIONS, &client_connections);
-			ts3Functions.getClientVariableAsString(serverConnectionHandlerID, (anyID)id, CLIENT_AWAY, &client_away);
-			ts3Functions.getClientVariableAsString(serverConnectionHandlerID, (anyID)id, CLIENT_AWAY_MESSAGE, &client_away_message);
-			ts3Functions.getClientVariableAsString(serverConnectionHandlerID, (anyID)id, CLIENT_FLAG_AVATAR, &client_avatar);
-			ts3Functions.getClientVariableAsString(serverConnectionHandlerID, (anyID)id, CLIENT_TALK_POWER, &client_tp);
-			ts3Functions.getClientVariableAsString(serverConnectionHandlerID, (anyID)id, CLIENT_TALK_REQUEST, &client_talk_request);
-			ts3Functions.getClientVariableAsString(serverConnectionHandlerID, (anyID)id, CLIENT_TALK_REQUEST_MSG, &client_talk_request_msg);
-			ts3Functions.getClientVariableAsString(serverConnectionHandlerID, (anyID)id, CLIENT_DESCRIPTION, &client_description);
-			ts3Functions.getClientVariableAsString(serverConnectionHandlerID, (anyID)id, CLIENT_IS_TALKER, &client_talker);
-			ts3Functions.getClientVariableAsString(serverConnectionHandlerID, (anyID)id, CLIENT_IS_PRIORITY_SPEAKER, &client_priority_speaker);
-			ts3Functions.getClientVariableAsString(serverConnectionHandlerID, (anyID)id, CLIENT_UNREAD_MESSAGES, &client_unread_messages);
-			ts3Functions.getClientVariableAsString(serverConnectionHandlerID, (anyID)id, CLIENT_NICKNAME_PHONETIC, &client_phonetic_nickname);
-			ts3Functions.getClientVariableAsString(serverConnectionHandlerID, (anyID)id, CLIENT_ICON_ID, &client_icon_id);
-			ts3Functions.getClientVariableAsString(serverConnectionHandlerID, (anyID)id, CLIENT_IS_CHANNEL_COMMANDER, &client_channel_commander);
-			ts3Functions.getClientVariableAsString(serverConnectionHandlerID, (anyID)id, CLIENT_COUNTRY, &client_country);
-			ts3Functions.getClientVariableAsString(serverConnectionHandlerID, (anyID)id, CLIENT_BADGES, &client_badges);
-
-			uint64 client_channel;
-			ts3Functions.getChannelOfClient(serverConnectionHandlerID, (anyID)id, &client_channel);
-			char* channel_needed_tp;
-			ts3Functions.getChannelVariableAsString(serverConnectionHandlerID, client_channel, CHANNEL_NEEDED_TALK_POWER, &channel_needed_tp);
-
-
-
-			//---------------------------------------------------------------------------
-
-			infodata += "CLIENT-RELATED:";
-			infodata += "\n";
-			infodata += "------------------------";
-			infodata += "\n";
-			
-			infodata += "name: [B]";
-			infodata += client_name;
-			infodata += "[/B]\n";
-			infodata += "uuid: [B]";
-			infodata += client_uid;
-			infodata += "[/B]\n";
-			infodata += "build: [B]";
-			infodata += client_version;
-			infodata += " on ";
-			infodata += client_platform;
-			infodata += "[/B]\n";
-			infodata += "client phonetic name: [B]";
-			infodata += client_phonetic_nickname;
-			infodata += "[/B]\n";
-			infodata += "country of client: [B]";
-			infodata += client_country;
-			infodata += "[/B]\n";
-			infodata += "badges of client: ";
-			{
-				std::vector<std::string> arr = split(client_badges, ':');
-				if (!arr.empty()) {
-					if (arr[0] == "overwolf=0") {
-						infodata += "";
-					}
-					else {
-						infodata += "[B]Overwolf[/B]";
-					}
-
-					if (arr.size() > 1) {
-						std::vector<std::string> arr2 = split(arr[1], ',');
-						//erase(arr2, 0, 0, 6);
-						arr2[0] = arr2[0].erase(0, 7);
-						//printf(arr[1].c_str());
-						for (std::vector<std::string>::iterator it = arr2.begin(); it != arr2.end(); it++) {
-							//printf(it->c_str());
-							if (it != arr2.begin()) {
-								infodata += " | [B]";
-							}
-							else {
-								infodata += "[B]";
-							}
-							infodata += guid_name(*it);
-							infodata += "[/B]";
-						}
-					infodata += "\n";
-					}
-				}
-
-			}
-
-
-			infodata += "\n";
-			infodata += "STATUS:";
-			infodata += "\n";
-			//infodata += "Is client talking: [B]";
-			//infodata += client_talking;
-			//infodata += "[/B]\n";
-			//infodata += "Is client's microphone muted: [B]";
-			//infodata += client_input_muted;
-			//infodata += "[/B]\n";
-			//infodata += "Is client's headset muted: [B]";
-			//infodata += client_output_muted;
-			//infodata += "[/B]\n";
-			////infodata += "Is client's outputonly muted: [B]";
-			////infodata += client_outputonly_muted;
-			////infodata += "[/B]\n";
-			//infodata += "Is client's microphone activated: [B]";
-			//infodata += client_input_hw;
-			//infodata += "[/B]\n";
-			//infodata += "Is client's headset activated: [B]";
-			//infodata += client_output_hw;
-			//infodata += "[/B]\n";
-			//infodata += "Is client away: [B]";
-			//infodata += client_away;
-			//infodata += "[/B]\n";
-			/*infodata += "Away-Message: [B]";
-			infodata += client_away_message;
-			infodata += "[/B]\n";*/
-			infodata += "has client requested tp: [B]";
-			infodata += client_talk_request;
-			infodata += "[/B]\n";
-			/*infodata += "talkpower request message: [B]";
-			infodata += client_talk_request_msg;
-			infodata += "[/B]\n";*/
-			infodata += "client-idle-time: [B]";
-			infodata += client_idle;
-			infodata += "[/B]\n";
-			infodata += "client-muted (by you): [B]";
-			infodata += client_muted;
-			infodata += "[/B]\n";
-			infodata += "is client recording: [B]";
-			infodata += client_recording;
-			infodata += "[/B]\n";
-			infodata += "\n";
-
-			//---------------
-
-			infodata += "SERVER-RELATED:";
-			infodata += "\n";
-			infodata += "------------------------";
-			infodata += "\n";
-
-			infodata += "databaseid: [B]";
-			infodata += client_dbid;
-			infodata += "[/B]\n";
-			infodata += "connections to server: [B]";
-			infodata += client_connections;
-			infodata += "[/B]\n";
-			infodata += "first connection of client: [B]";
-			infodata += get_time_string(atoi(client_created));;
-			infodata += "[/B]\n";
-
-			infodata += "\n";
-			infodata += "GROUPS: [B]";
-			infodata += "[/B]\n";
-			infodata += "\n";
-			infodata += "servergroupid(s): [B]";
-			infodata += client_server_groups;
-			infodata += "[/B]\n";
-			infodata += "channelgroupid: [B]";
-			infodata += client_channel_group_id;
-			infodata += "[/B]\n";
-
-			//---------------
-
-			infodata += "\n";
-			infodata += "PERMS:";
-			infodata += "\n";
-			infodata += "------------------------";
-			infodata += "\n";
-
-			infodata += "client talkpower: [B]";
-			infodata += client_tp;
-			infodata += "[/B] | [B]";
-			infodata += channel_needed_tp;
-			infodata += "[/B]\n";
-			infodata += "client avatar id: [B]";
-			infodata += client_avatar;
-			infodata += "[/B]\n";
-			infodata += "client icon id: [B]";
-			infodata += client_icon_id;
-			infodata += "[/B]\n";
-			infodata += "client is talker: [B]";
-			infodata += client_talker;
-			infodata += "[/B]\n";
-			infodata += "client is priority speaker: [B]";
-			infodata += client_priority_speaker;
-			infodata += "[/B]\n";
-			infodata += "unread messages clientside: [B]";
-			infodata += client_unread_messages;
-			infodata += "[/B]\n";
-			infodata += "client channel commander: [B]";
-			infodata += client_channel_commander;
-			infodata += "[/B]\n";
-
-			//---------------
-
-			/*infodata += "Client description: [B]";
-			infodata += client_description;
-			infodata += "[/B]\n";*/
-			
-			
-
-
-			//snprintf(*data, INFODATA_BUFSIZE, "Client-NAME: [B]\%s\[/B]\n\Client-UID: [B]\%s\[/B]\n\Client-VERSION: [B]\%s\[/B]", client_name, client_uid, client_version);  /* bbCode is supported. HTML is not supported */
-			
 			break;
-
 		default:
 			printf("Invalid item type: %d\n", type);
-			//data = NULL;  /* Ignore */
-			fail = true;
+			*data = NULL;  /* Ignore */
 			return;
 	}
-	if (!fail) {
-		*data = (char*)malloc((infodata.length() + 1) * sizeof(char));
-		snprintf(*data, (infodata.length() + 1), infodata.c_str());
+
+	connection_panel_shown(serverConnectionHandlerID, type == PLUGIN_CHANNEL ? id : 0);
+	check_connection_budget(serverConnectionHandlerID);
+	unsigned long calls_before = sdk_variable_calls.load();
+	pool_string infodata(last_render_bytes[type].load());  /* sized like the last render, so it rarely grows */
+	if (type == PLUGIN_SERVER) {
+		render_server_info(serverConnectionHandlerID, infodata);
+	}
+	else {
+		reused_layout_values values(panel_fields[type].count);
+		render_layout(*current_layout(type), panel_fields[type], serverConnectionHandlerID, id, *values.values, infodata);
 	}
-#pragma warning( pop )
+	last_render_sdk_calls[type].store(sdk_variable_calls.load() - calls_before);
+	last_render_bytes[type].store(infodata.size());
+	*data = infodata.release();  /* handed back through ts3plugin_freeMemory */
 }
 
 /* Required to release the memory for parameter "data" allocated in ts3plugin_infoData and ts3plugin_initMenus */
 void ts3plugin_freeMemory(void* data) {
-	free(data);
+	pool_free(data);
 }
 
 /*
@@ -845,3 +383,177 @@ void ts3plugin_freeMemory(void* data) {
 int ts3plugin_requestAutoload() {
 	return 0;  /* 1 = request autoloaded, 0 = do not request autoload */
 }
+
+/************************** TeamSpeak callbacks ***************************/
+/*
+ * Following functions are optional, feel free to remove unused callbacks.
+ * See the clientlib documentation for details on each function.
+ */
+
+void ts3plugin_onConnectStatusChangeEvent(uint64 serverConnectionHandlerID, int newStatus, unsigned int errorNumber) {
+	if (newStatus == STATUS_CONNECTION_ESTABLISHED) {
+		open_connection_state(serverConnectionHandlerID);
+		record_visible_clients(serverConnectionHandlerID);
+		feed_observe_connection(serverConnectionHandlerID);
+		request_shared_history(serverConnectionHandlerID);
+	}
+	else if (newStatus == STATUS_DISCONNECTED) {
+		close_connection_state(serverConnectionHandlerID);
+	}
+}
+
+void ts3plugin_onServerUpdatedEvent(uint64 serverConnectionHandlerID) {
+	/* Replaces cached server values shown since connecting */
+	bool was_live = server_info_live(serverConnectionHandlerID);
+	set_server_info_live(serverConnectionHandlerID, true);
+	if (!was_live) {
+		ts3Functions.requestInfoUpdate(serverConnectionHandlerID, PLUGIN_SERVER, serverConnectionHandlerID);
+	}
+	feed_observe(serverConnectionHandlerID, FEED_SERVER, 0);
+}
+
+void ts3plugin_onServerEditedEvent(uint64 serverConnectionHandlerID, anyID editerID, const char* editerName, const char* editerUniqueIdentifier) {
+	feed_changed(serverConnectionHandlerID, FEED_SERVER, 0, editerID, editerName);
+	check_connection_budget(serverConnectionHandlerID);
+}
+
+void ts3plugin_onNewChannelEvent(uint64 serverConnectionHandlerID, uint64 channelID, uint64 channelParentID) {
+	feed_observe(serverConnectionHandlerID, FEED_CHANNEL, channelID);
+}
+
+void ts3plugin_onNewChannelCreatedEvent(uint64 serverConnectionHandlerID, uint64 channelID, uint64 channelParentID, anyID invokerID, const char* invokerName, const char* invokerUniqueIdentifier) {
+	feed_observe(serverConnectionHandlerID, FEED_CHANNEL, channelID);
+}
+
+void ts3plugin_onUpdateChannelEvent(uint64 serverConnectionHandlerID, uint64 channelID) {
+	feed_observe(serverConnectionHandlerID, FEED_CHANNEL, channelID);
+}
+
+void ts3plugin_onUpdateChannelEditedEvent(uint64 serverConnectionHandlerID, uint64 channelID, anyID invokerID, const char* invokerName, const char* invokerUniqueIdentifier) {
+	feed_changed(serverConnectionHandlerID, FEED_CHANNEL, channelID, invokerID, invokerName);
+	check_connection_budget(serverConnectionHandlerID);
+}
+
+void ts3plugin_onDelChannelEvent(uint64 serverConnectionHandlerID, uint64 channelID, anyID invokerID, const char* invokerName, const char* invokerUniqueIdentifier) {
+	forget_channel_storage(serverConnectionHandlerID, channelID);
+	forget_channel_description(serverConnectionHandlerID, channelID);
+	feed_forget(serverConnectionHandlerID, FEED_CHANNEL, channelID);
+}
+
+void ts3plugin_onClientMoveEvent(uint64 serverConnectionHandlerID, anyID clientID, uint64 oldChannelID, uint64 newChannelID, int visibility, const char* moveMessage) {
+	if (visibility == LEAVE_VISIBILITY) {
+		release_voice_meter(serverConnectionHandlerID, clientID);
+		feed_forget(serverConnectionHandlerID, FEED_CLIENT, clientID);
+	}
+	else {
+		record_client_sighting(serverConnectionHandlerID, clientID);
+		feed_observe(serverConnectionHandlerID, FEED_CLIENT, clientID);
+		check_connection_budget(serverConnectionHandlerID);
+	}
+}
+
+/* Visible by subscribing to the client's channel, gone by unsubscribing */
+void ts3plugin_onClientMoveSubscriptionEvent(uint64 serverConnectionHandlerID, anyID clientID, uint64 oldChannelID, uint64 newChannelID, int visibility) {
+	if (visibility == LEAVE_VISIBILITY) {
+		release_voice_meter(serverConnectionHandlerID, clientID);
+		feed_forget(serverConnectionHandlerID, FEED_CLIENT, clientID);
+	}
+	else {
+		record_client_sighting(serverConnectionHandlerID, clientID);
+		feed_observe(serverConnectionHandlerID, FEED_CLIENT, clientID);
+		check_connection_budget(serverConnectionHandlerID);
+	}
+}
+
+void ts3plugin_onClientMoveTimeoutEvent(uint64 serverConnectionHandlerID, anyID clientID, uint64 oldChannelID, uint64 newChannelID, int visibility, const char* timeoutMessage) {
+	release_voice_meter(serverConnectionHandlerID, clientID);
+	feed_forget(serverConnectionHandlerID, FEED_CLIENT, clientID);
+}
+
+/* Moved by someone else */
+void ts3plugin_onClientMoveMovedEvent(uint64 serverConnectionHandlerID, anyID clientID, uint64 oldChannelID, uint64 newChannelID, int visibility, anyID moverID, const char* moverName, const char* moverUniqueIdentifier, const char* moveMessage) {
+	if (visibility == LEAVE_VISIBILITY) {
+		release_voice_meter(serverConnectionHandlerID, clientID);
+		feed_forget(serverConnectionHandlerID, FEED_CLIENT, clientID);
+	}
+	else {
+		record_client_sighting(serverConnectionHandlerID, clientID);
+		feed_observe(serverConnectionHandlerID, FEED_CLIENT, clientID);
+		check_connection_budget(serverConnectionHandlerID);
+	}
+}
+
+/* Kicked into a channel we do not see */
+void ts3plugin_onClientKickFromChannelEvent(uint64 serverConnectionHandlerID, anyID clientID, uint64 oldChannelID, uint64 newChannelID, int visibility, anyID kickerID, const char* kickerName, const char* kickerUniqueIdentifier, const char* kickMessage) {
+	if (visibility == LEAVE_VISIBILITY) {
+		release_voice_meter(serverConnectionHandlerID, clientID);
+		feed_forget(serverConnectionHandlerID, FEED_CLIENT, clientID);
+	}
+}
+
+void ts3plugin_onClientKickFromServerEvent(uint64 serverConnectionHandlerID, anyID clientID, uint64 oldChannelID, uint64 newChannelID, int visibility, anyID kickerID, const char* kickerName, const char* kickerUniqueIdentifier, const char* kickMessage) {
+	release_voice_meter(serverConnectionHandlerID, clientID);
+	feed_forget(serverConnectionHandlerID, FEED_CLIENT, clientID);
+}
+
+void ts3plugin_onClientBanFromServerEvent(uint64 serverConnectionHandlerID, anyID clientID, uint64 oldChannelID, uint64 newChannelID, int visibility, anyID kickerID, const char* kickerName, const char* kickerUniqueIdentifier, uint64 time, const char* kickMessage) {
+	release_voice_meter(serverConnectionHandlerID, clientID);
+	feed_forget(serverConnectionHandlerID, FEED_CLIENT, clientID);
+}
+
+void ts3plugin_onUpdateClientEvent(uint64 serverConnectionHandlerID, anyID clientID, anyID invokerID, const char* invokerName, const char* invokerUniqueIdentifier) {
+	export_client_updated(serverConnectionHandlerID, clientID);
+	feed_changed(serverConnectionHandlerID, FEED_CLIENT, clientID, invokerID, invokerName);
+	check_connection_budget(serverConnectionHandlerID);
+}
+
+void ts3plugin_onChannelDescriptionUpdateEvent(uint64 serverConnectionHandlerID, uint64 channelID) {
+	channel_description_updated(serverConnectionHandlerID, channelID);
+}
+
+int ts3plugin_onServerErrorEvent(uint64 serverConnectionHandlerID, const char* errorMessage, unsigned int error, const char* returnCode, const char* extraMessage) {
+	if (channel_storage_error(serverConnectionHandlerID, returnCode, error, errorMessage)) {
+		return 1;  /* Error was caused by one of our file list requests, client will ignore it */
+	}
+	return 0;  /* Client will handle the error */
+}
+
+void ts3plugin_onAvatarUpdated(uint64 serverConnectionHandlerID, anyID clientID, const char* avatarPath) {
+	avatar_updated(serverConnectionHandlerID, clientID);
+}
+
+void ts3plugin_onPluginCommandEvent(uint64 serverConnectionHandlerID, const char* pluginName, const char* pluginCommand) {
+	exchange_plugin_command(serverConnectionHandlerID, pluginCommand);
+}
+
+void ts3plugin_onServerStopEvent(uint64 serverConnectionHandlerID, const char* shutdownMessage) {
+	close_connection_state(serverConnectionHandlerID);
+}
+
+/*
+ * Called on the audio thread for every voice buffer of another client before it is played back.
+ * The samples are only measured, never modified.
+ */
+void ts3plugin_onEditPlaybackVoiceDataEvent(uint64 serverConnectionHandlerID, anyID clientID, short* samples, int sampleCount, int channels) {
+	meter_voice_data(serverConnectionHandlerID, clientID, samples, sampleCount, channels);
+}
+
+/*
+ * Called on the audio thread for our own captured voice. *edited is left untouched,
+ * the data is only measured for the microphone diagnostics.
+ */
+void ts3plugin_onEditCapturedVoiceDataEvent(uint64 serverConnectionHandlerID, short* samples, int sampleCount, int channels, int* edited) {
+	diagnose_captured_voice_data(serverConnectionHandlerID, samples, sampleCount, channels);
+}
+
+void ts3plugin_onFileListEvent(uint64 serverConnectionHandlerID, uint64 channelID, const char* path, const char* name, uint64 size, uint64 datetime, int type, uint64 incompletesize, const char* returnCode) {
+	channel_storage_entry(serverConnectionHandlerID, channelID, path, name, size, datetime, type, incompletesize, returnCode);
+}
+
+void ts3plugin_onFileListFinishedEvent(uint64 serverConnectionHandlerID, uint64 channelID, const char* path) {
+	channel_storage_finished(serverConnectionHandlerID, channelID, path);
+}
+
+void ts3plugin_onFileTransferStatusEvent(anyID transferID, unsigned int status, const char* statusMessage, uint64 remotefileSize, uint64 serverConnectionHandlerID) {
+	invalidate_channel_storage(serverConnectionHandlerID);
+}
@@ -0,0 +1,281 @@
+#pragma once
+
+#include <ctime>
+#include <map>
+#include <mutex>
+#include <stddef.h>
+#include <string>
+#include <string.h>
+#include <utility>
+
+#include "mapped_file.h"
+
+/*
+Last known server panel values, kept on disk per server unique identifier, so the server panel can show them right
+after connecting instead of waiting for the extended server variables. Shown marked as cached until the server
+answered; the first live render then replaces the snapshot.
+
+The store is one fixed-size mapped file of SNAPSHOT_SLOTS slots. When full, the oldest saved slot is reused; showing a
+snapshot does not refresh it, so this is not least recently used.
+Each slot holds two checksummed copies and a write only ever touches the older one, so a crash mid-write leaves
+the previous snapshot readable. Live values are collected in memory and written at most every SNAPSHOT_FLUSH_SECONDS,
+on disconnect and on shutdown.
+*/
+
+#define SNAPSHOT_FILENAME "KeyinatorsMoreInfo_servers.dat"
+#define SNAPSHOT_MAGIC 0x31534E5049464E49ull  /* "INFIPNS1" */
+#define SNAPSHOT_SLOTS 32
+#define SNAPSHOT_UID_BYTES 64
+#define SNAPSHOT_PAYLOAD_BYTES 8192
+#define SNAPSHOT_FLUSH_SECONDS 30
+
+struct snapshot_file_header {
+	unsigned long long magic;
+	unsigned int slots;
+	unsigned int payload_bytes;
+};
+
+/* payload is a sequence of "name\0value\0" */
+struct snapshot_record {
+	unsigned long long checksum;  /* hash_string of generation up to the end of the payload */
+	unsigned long long generation;
+	unsigned long long saved_at;
+	unsigned int length;
+	unsigned int reserved;
+	char uid[SNAPSHOT_UID_BYTES];
+	char payload[SNAPSHOT_PAYLOAD_BYTES];
+};
+
+struct snapshot_slot {
+	snapshot_record copies[2];
+};
+
+/* By field name, looked up with the names of the field table without building a string */
+typedef std::map<std::string, std::string, std::less<> > snapshot_values;
+
+struct server_snapshot {
+	unsigned long long saved_at;
+	snapshot_values values;
+};
+
+static mapped_file snapshot_file;
+static std::map<std::string, int> snapshot_index;  /* uid -> slot */
+static std::map<std::string, server_snapshot> snapshot_pending;  /* not yet written */
+static std::map<uint64, bool> snapshot_live;  /* connections whose server variables arrived */
+static time_t snapshot_last_flush = 0;
+static std::mutex snapshot_mutex;
+
+static snapshot_slot* snapshot_slots() {
+	return (snapshot_slot*)(snapshot_file.data + sizeof(snapshot_file_header));
+}
+
+static unsigned long long snapshot_checksum(const snapshot_record& record) {
+	return hash_string((const char*)&record.generation, offsetof(snapshot_record, payload) - offsetof(snapshot_record, generation) + record.length);
+}
+
+static bool snapshot_valid(const snapshot_record& record) {
+	return record.length <= SNAPSHOT_PAYLOAD_BYTES && record.uid[SNAPSHOT_UID_BYTES - 1] == '\0' && record.checksum == snapshot_checksum(record);
+}
+
+/* Newest intact copy of a slot, NULL if it holds none */
+static const snapshot_record* snapshot_current(const snapshot_slot& slot) {
+	bool valid0 = snapshot_valid(slot.copies[0]);
+	bool valid1 = snapshot_valid(slot.copies[1]);
+	if (valid0 && (!valid1 || slot.copies[0].generation > slot.copies[1].generation)) return &slot.copies[0];
+	if (valid1) return &slot.copies[1];
+	return NULL;
+}
+
+void open_snapshot_store() {
+	std::lock_guard<std::mutex> lock(snapshot_mutex);
+	if (snapshot_file.data) return;
+	std::string path = config_file_path(SNAPSHOT_FILENAME);
+	if (!map_file(path, sizeof(snapshot_file_header) + SNAPSHOT_SLOTS * sizeof(snapshot_slot), snapshot_file)) {
+		printf("PLUGIN: could not map %s, server snapshots disabled\n", path.c_str());
+		return;
+	}
+	snapshot_file_header* header = (snapshot_file_header*)snapshot_file.data;
+	if (header->magic != SNAPSHOT_MAGIC || header->slots != SNAPSHOT_SLOTS || header->payload_bytes != SNAPSHOT_PAYLOAD_BYTES) {
+		memset(snapshot_file.data, 0, snapshot_file.size);
+		header->magic = SNAPSHOT_MAGIC;
+		header->slots = SNAPSHOT_SLOTS;
+		header->payload_bytes = SNAPSHOT_PAYLOAD_BYTES;
+		flush_mapped_file(snapshot_file);
+	}
+	snapshot_index.clear();
+	for (int i = 0; i < SNAPSHOT_SLOTS; i++) {
+		const snapshot_record* record = snapshot_current(snapshot_slots()[i]);
+		if (record) snapshot_index[record->uid] = i;
+	}
+	snapshot_last_flush = time(NULL);
+}
+
+/* Writes into the older copy of the server's slot, or of the oldest saved slot if the server has none */
+static void snapshot_write(const std::string& uid, const server_snapshot& snapshot) {
+	std::map<std::string, int>::iterator it = snapshot_index.find(uid);
+	int slot = -1;
+	if (it != snapshot_index.end()) {
+		slot = it->second;
+	}
+	else {
+		unsigned long long oldest = 0;
+		for (int i = 0; i < SNAPSHOT_SLOTS; i++) {
+			const snapshot_record* record = snapshot_current(snapshot_slots()[i]);
+			if (!record) {
+				slot = i;
+				break;
+			}
+			if (slot < 0 || record->saved_at < oldest) {
+				slot = i;
+				oldest = record->saved_at;
+			}
+		}
+		const snapshot_record* evicted = snapshot_current(snapshot_slots()[slot]);
+		if (evicted) snapshot_index.erase(evicted->uid);
+		snapshot_index[uid] = slot;
+		/* The evicted server's copies must not be taken for this server's after a torn write */
+		snapshot_slots()[slot].copies[0].checksum = 0;
+		snapshot_slots()[slot].copies[1].checksum = 0;
+	}
+
+	snapshot_slot& target = snapshot_slots()[slot];
+	const snapshot_record* current = snapshot_current(target);
+	snapshot_record& record = current == &target.copies[0] ? target.copies[1] : target.copies[0];
+
+	/* Invalidate first, so a torn write is never taken for a valid copy */
+	record.checksum = 0;
+	record.generation = current ? current->generation + 1 : 1;
+	record.saved_at = snapshot.saved_at;
+	record.reserved = 0;
+	memset(record.uid, 0, SNAPSHOT_UID_BYTES);
+	uid.copy(record.uid, SNAPSHOT_UID_BYTES - 1);
+	size_t length = 0;
+	for (snapshot_values::const_iterator value = snapshot.values.begin(); value != snapshot.values.end(); value++) {
+		size_t size = value->first.size() + value->second.size() + 2;
+		if (length + size > SNAPSHOT_PAYLOAD_BYTES) continue;  /* a value that does not fit is left out */
+		memcpy(record.payload + length, value->first.c_str(), value->first.size() + 1);
+		memcpy(record.payload + length + value->first.size() + 1, value->second.c_str(), value->second.size() + 1);
+		length += size;
+	}
+	record.length = (unsigned int)length;
+	record.checksum = snapshot_checksum(record);
+}
+
+static void flush_server_snapshots_locked() {
+	snapshot_last_flush = time(NULL);
+	if (!snapshot_file.data || snapshot_pending.empty()) return;
+	for (std::map<std::string, server_snapshot>::const_iterator it = snapshot_pending.begin(); it != snapshot_pending.end(); it++) {
+		snapshot_write(it->first, it->second);
+	}
+	snapshot_pending.clear();
+	flush_mapped_file(snapshot_file);
+}
+
+void flush_server_snapshots() {
+	std::lock_guard<std::mutex> lock(snapshot_mutex);
+	flush_server_snapshots_locked();
+}
+
+void close_snapshot_store() {
+	std::lock_guard<std::mutex> lock(snapshot_mutex);
+	flush_server_snapshots_locked();
+	unmap_file(snapshot_file);
+	snapshot_index.clear();
+}
+
+bool read_server_snapshot(const std::string& uid, server_snapshot& out) {
+	std::lock_guard<std::mutex> lock(snapshot_mutex);
+	std::map<std::string, server_snapshot>::const_iterator pending = snapshot_pending.find(uid);
+	if (pending != snapshot_pending.end()) {
+		out = pending->second;
+		return true;
+	}
+	std::map<std::string, int>::const_iterator it = snapshot_index.find(uid);
+	if (it == snapshot_index.end()) return false;
+	const snapshot_record* record = snapshot_current(snapshot_slots()[it->second]);
+	if (!record || uid.compare(record->uid) != 0) return false;
+
+	out.saved_at = record->saved_at;
+	out.values.clear();
+	size_t pos = 0;
+	while (pos < record->length) {
+		const char* name = record->payload + pos;
+		size_t name_length = strnlen(name, record->length - pos);
+		if (pos + name_length + 1 >= record->length) break;
+		const char* value = name + name_length + 1;
+		size_t value_length = strnlen(value, record->length - pos - name_length - 1);
+		out.values[std::string(name, name_length)] = std::string(value, value_length);
+		pos += name_length + value_length + 2;
+	}
+	return true;
+}
+
+/*
+Queues the fetched values of a render for the next batched write. The pending values are updated in place, so renders
+between two writes allocate nothing here; a field not fetched this time keeps its pending value.
+*/
+void store_server_snapshot(const std::string& uid, const layout_fields& fields, const layout_values& values) {
+	std::lock_guard<std::mutex> lock(snapshot_mutex);
+	server_snapshot& snapshot = snapshot_pending[uid];
+	snapshot.saved_at = (unsigned long long)time(NULL);
+	for (size_t i = 0; i < fields.count; i++) {
+		if (!values.fetched[i]) continue;
+		snapshot_values::iterator it = snapshot.values.find(fields.fields[i].name);
+		if (it == snapshot.values.end()) snapshot.values.insert(std::make_pair(std::string(fields.fields[i].name), values.values[i]));
+		else if (it->second != values.values[i]) it->second = values.values[i];
+	}
+	if (time(NULL) - snapshot_last_flush >= SNAPSHOT_FLUSH_SECONDS) {
+		flush_server_snapshots_locked();
+	}
+}
+
+void set_server_info_live(uint64 serverConnectionHandlerID, bool live) {
+	std::lock_guard<std::mutex> lock(snapshot_mutex);
+	if (live && connection_open(serverConnectionHandlerID)) snapshot_live[serverConnectionHandlerID] = true;
+	else snapshot_live.erase(serverConnectionHandlerID);
+}
+
+static bool server_info_live(uint64 serverConnectionHandlerID) {
+	std::lock_guard<std::mutex> lock(snapshot_mutex);
+	return snapshot_live.count(serverConnectionHandlerID) != 0;
+}
+
+/*
+Renders the server panel into out. Until the server variables arrived, fields are filled from the snapshot where there
+is one; afterwards every fetched field goes into the snapshot.
+*/
+void render_server_info(uint64 serverConnectionHandlerID, pool_string& out) {
+	static const int uid_field = layout_field_id(panel_fields[PLUGIN_SERVER], "unique_identifier");
+	const layout_fields& fields = panel_fields[PLUGIN_SERVER];
+	std::shared_ptr<const layout_program> layout = current_layout(PLUGIN_SERVER);  /* keeps it alive across a reload */
+	const layout_program& program = *layout;
+	reused_layout_values reused(fields.count);
+	layout_values& values = *reused.values;
+	fields.fields[uid_field].fetch(serverConnectionHandlerID, 0, values.values[uid_field]);  /* also the {{unique_identifier}} field */
+	values.fetched[uid_field] = true;
+	const std::string& uid = values.values[uid_field];
+	if (uid.empty()) {
+		render_layout(program, fields, serverConnectionHandlerID, 0, values, out);
+		return;
+	}
+
+	if (!server_info_live(serverConnectionHandlerID)) {
+		server_snapshot snapshot;
+		if (!read_server_snapshot(uid, snapshot)) {
+			render_layout(program, fields, serverConnectionHandlerID, 0, values, out);
+			return;
+		}
+		for (size_t i = 0; i < fields.count; i++) {
+			snapshot_values::const_iterator it = snapshot.values.find(fields.fields[i].name);
+			if (it == snapshot.values.end() || values.fetched[i]) continue;
+			values.values[i] = it->second;
+			values.fetched[i] = true;
+		}
+		out += "[I]cached values from " + age_string((long long)time(NULL) - (long long)snapshot.saved_at) + " ago, refreshing...[/I]\n\n";
+		render_layout(program, fields, serverConnectionHandlerID, 0, values, out);
+		return;
+	}
+
+	render_layout(program, fields, serverConnectionHandlerID, 0, values, out);
+	store_server_snapshot(uid, fields, values);
+}
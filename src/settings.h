@@ -0,0 +1,256 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <ctime>
+#include <map>
+#include <mutex>
+#include <stdlib.h>
+#include <string>
+#include <thread>
+
+#include "utf8_file.h"
+
+#ifdef _WIN32
+#include <shellapi.h>
+#else
+#include <spawn.h>
+#include <sys/wait.h>
+#ifdef __APPLE__
+#include <crt_externs.h>
+#define KMI_ENVIRON (*_NSGetEnviron())
+#else
+extern char** environ;
+#define KMI_ENVIRON environ
+#endif
+#endif
+
+/*
+Persisted plugin settings, a plain key=value file in the config directory:
+	section.<name>=0|1         switch a layout section off or on
+	description_max_length=N   bytes of a channel description kept and shown
+	connection_budget_kb=N     memory one server connection may hold before its caches are trimmed
+	exchange=0|1               share client history with other users of the plugin, see info_exchange.h
+A switched off section is skipped by the renderer before any of its fields is fetched.
+*/
+
+#define SETTINGS_FILENAME "KeyinatorsMoreInfo_settings.ini"
+#define DEFAULT_CONNECTION_BUDGET_KB 4096
+
+static std::atomic<size_t> connection_budget_kb(DEFAULT_CONNECTION_BUDGET_KB);  /* see connection_state.h */
+static std::atomic<bool> exchange_enabled(false);
+
+static std::map<std::string, bool> section_settings;
+static std::mutex section_settings_mutex;
+
+static std::string config_file_path(const char* filename) {
+	char configPath[PATH_BUFSIZE];
+	ts3Functions.getConfigPath(configPath, PATH_BUFSIZE);
+	std::string path = configPath;
+	if (!path.empty() && path[path.size() - 1] != '/' && path[path.size() - 1] != '\\') path += "/";
+	return path + filename;
+}
+
+/* Pushes the stored switches to the compiled sections. Sections without a setting are on. */
+void apply_section_settings() {
+	std::lock_guard<std::mutex> names_lock(layout_sections_mutex);
+	std::lock_guard<std::mutex> lock(section_settings_mutex);
+	for (size_t i = 0; i < layout_section_names.size(); i++) {
+		std::map<std::string, bool>::const_iterator it = section_settings.find(layout_section_names[i]);
+		layout_section_disabled[i].store(it != section_settings.end() && !it->second, std::memory_order_relaxed);
+	}
+}
+
+void load_settings() {
+	std::string content;
+	{
+		std::lock_guard<std::mutex> lock(section_settings_mutex);
+		section_settings.clear();
+		if (read_file(config_file_path(SETTINGS_FILENAME), content)) {
+			std::vector<std::string> lines = split(content, '\n');
+			for (size_t i = 0; i < lines.size(); i++) {
+				std::string line = trim(lines[i]);
+				if (line.empty() || line[0] == ';' || line[0] == '#') continue;
+				size_t eq = line.find('=');
+				if (eq == std::string::npos) continue;
+				std::string key = trim(line.substr(0, eq));
+				std::string value = trim(line.substr(eq + 1));
+				if (key.compare(0, 8, "section.") == 0) {
+					section_settings[key.substr(8)] = value != "0";
+				}
+				else if (key == "description_max_length") {
+					long length = atol(value.c_str());
+					if (length > 0) description_max_length.store((size_t)length);
+				}
+				else if (key == "connection_budget_kb") {
+					long budget = atol(value.c_str());
+					if (budget > 0) connection_budget_kb.store((size_t)budget);
+				}
+				else if (key == "exchange") {
+					exchange_enabled.store(value == "1");
+				}
+			}
+		}
+	}
+	apply_section_settings();
+}
+
+/* Writes every known section, so the file doubles as the list of what can be switched */
+bool save_settings() {
+	std::string content = "; Keyinator's More Info settings. Set a section to 0 to hide it and skip fetching its values.\n";
+	content += "description_max_length=" + std::to_string(description_max_length.load()) + "\n";
+	content += "connection_budget_kb=" + std::to_string(connection_budget_kb.load()) + "\n";
+	content += std::string("exchange=") + (exchange_enabled.load() ? "1" : "0") + "\n";
+	{
+		std::lock_guard<std::mutex> names_lock(layout_sections_mutex);
+		for (size_t i = 0; i < layout_section_names.size(); i++) {
+			content += "section." + layout_section_names[i] + "=" + (layout_section_disabled[i].load(std::memory_order_relaxed) ? "0" : "1") + "\n";
+		}
+	}
+	return write_file(config_file_path(SETTINGS_FILENAME), content);
+}
+
+/* Returns false if no compiled layout uses a section of that name */
+bool set_section_enabled(const std::string& name, bool enabled) {
+	{
+		std::lock_guard<std::mutex> names_lock(layout_sections_mutex);
+		size_t i = 0;
+		while (i < layout_section_names.size() && layout_section_names[i] != name) i++;
+		if (i == layout_section_names.size()) return false;
+		layout_section_disabled[i].store(!enabled, std::memory_order_relaxed);
+	}
+	{
+		std::lock_guard<std::mutex> lock(section_settings_mutex);
+		section_settings[name] = enabled;
+	}
+	save_settings();
+	return true;
+}
+
+std::string sections_string() {
+	std::string result;
+	std::lock_guard<std::mutex> names_lock(layout_sections_mutex);
+	for (size_t i = 0; i < layout_section_names.size(); i++) {
+		result += layout_section_names[i];
+		result += layout_section_disabled[i].load(std::memory_order_relaxed) ? ": off\n" : ": on\n";
+	}
+	return result;
+}
+
+/*
+The settings "dialog" opens the settings file in an editor: Notepad on Windows, the desktop's default application
+elsewhere. A watcher thread applies every save of the file until the editor process ends, or for
+SETTINGS_EDITOR_WATCH_SECONDS when the opener does not stay around to be waited on. It polls, so
+stop_settings_editor ends it within SETTINGS_EDITOR_POLL_MS; ts3plugin_shutdown joins it before the plugin unloads.
+The editor itself is a separate process and stays open.
+*/
+
+#define SETTINGS_EDITOR_POLL_MS 1000
+#define SETTINGS_EDITOR_WATCH_SECONDS 600
+
+#ifdef _WIN32
+typedef HANDLE settings_editor_process;
+#else
+typedef pid_t settings_editor_process;
+#endif
+
+static std::thread settings_editor_thread;
+static std::mutex settings_editor_mutex;
+static std::condition_variable settings_editor_wake;
+static bool settings_editor_stop = false;
+static std::mutex settings_editor_control_mutex;  /* serializes starting and stopping the watcher */
+
+/* NULL or 0 if the editor could not be started */
+static settings_editor_process open_settings_editor(const std::string& path) {
+#ifdef _WIN32
+	SHELLEXECUTEINFOW info;
+	memset(&info, 0, sizeof(info));
+	info.cbSize = sizeof(info);
+	info.fMask = SEE_MASK_NOCLOSEPROCESS;
+	info.lpVerb = L"open";
+	info.lpFile = L"notepad.exe";
+	std::wstring parameters = L"\"" + utf8_to_wide(path.c_str()) + L"\"";
+	info.lpParameters = parameters.c_str();
+	info.nShow = SW_SHOWNORMAL;
+	return ShellExecuteExW(&info) ? info.hProcess : NULL;
+#else
+#ifdef __APPLE__
+	const char* opener = "open";
+#else
+	const char* opener = "xdg-open";
+#endif
+	char* argv[] = { (char*)opener, (char*)path.c_str(), NULL };
+	pid_t pid;
+	return posix_spawnp(&pid, opener, NULL, NULL, argv, KMI_ENVIRON) == 0 ? pid : 0;
+#endif
+}
+
+/* True while the editor process runs. Elsewhere it is the opener, which usually returns at once; it is reaped here. */
+static bool settings_editor_running(settings_editor_process& editor) {
+	if (!editor) return false;
+#ifdef _WIN32
+	return WaitForSingleObject(editor, 0) == WAIT_TIMEOUT;
+#else
+	if (waitpid(editor, NULL, WNOHANG) == 0) return true;
+	editor = 0;
+	return false;
+#endif
+}
+
+static void settings_editor_watch(settings_editor_process editor) {
+	std::string path = config_file_path(SETTINGS_FILENAME);
+	std::string saved;
+	read_file(path, saved);
+	time_t watch_until = time(NULL) + SETTINGS_EDITOR_WATCH_SECONDS;
+	bool watching = true;
+	while (watching) {
+		{
+			std::unique_lock<std::mutex> lock(settings_editor_mutex);
+			if (settings_editor_wake.wait_for(lock, std::chrono::milliseconds(SETTINGS_EDITOR_POLL_MS), [] { return settings_editor_stop; })) break;
+		}
+#ifdef _WIN32
+		watching = editor ? settings_editor_running(editor) : time(NULL) < watch_until;
+#else
+		settings_editor_running(editor);
+		watching = editor || time(NULL) < watch_until;
+#endif
+		std::string content;
+		if (read_file(path, content) && content != saved) {
+			saved.swap(content);
+			load_settings();
+		}
+	}
+#ifdef _WIN32
+	if (editor) CloseHandle(editor);
+#else
+	if (editor) waitpid(editor, NULL, WNOHANG);
+#endif
+}
+
+static void stop_settings_editor_locked() {
+	{
+		std::lock_guard<std::mutex> lock(settings_editor_mutex);
+		settings_editor_stop = true;
+	}
+	settings_editor_wake.notify_all();
+	if (settings_editor_thread.joinable()) settings_editor_thread.join();
+}
+
+/* From ts3plugin_configure. A watcher of an earlier call is replaced. */
+void edit_settings() {
+	std::lock_guard<std::mutex> control(settings_editor_control_mutex);
+	stop_settings_editor_locked();
+	save_settings();
+	settings_editor_process editor = open_settings_editor(config_file_path(SETTINGS_FILENAME));
+	{
+		std::lock_guard<std::mutex> lock(settings_editor_mutex);
+		settings_editor_stop = false;
+	}
+	settings_editor_thread = std::thread(settings_editor_watch, editor);
+}
+
+void stop_settings_editor() {
+	std::lock_guard<std::mutex> control(settings_editor_control_mutex);
+	stop_settings_editor_locked();
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+/*
+Compiler and CPU feature detection for the vectorized paths (voice_meter.h, bbcode.h).
+KMI_HAVE_SSE2 is set where SSE2 is part of the target; AVX2 code is compiled with KMI_TARGET_AVX2 and only called
+after a runtime check.
+*/
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define KMI_HAVE_SSE2
+#include <emmintrin.h>
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define KMI_TARGET_AVX2
+#else
+#define KMI_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+/*
+Interned strings. Every distinct value is stored once and referred to by a 32-bit handle; equal values get equal
+handles, so comparing two values is comparing handles. Handle 0 is the empty string, a zeroed handle is a valid one.
+Single values are not removed. To drop the ones nothing refers to any more, the owner re-interns the handles it still
+holds into a new table and swaps it in (see compact_change_feed, one table per connection).
+*/
+
+#define STRING_HANDLE_EMPTY 0
+
+struct string_table {
+	std::string bytes;              /* the values, each followed by '\0' */
+	std::vector<uint32_t> offsets;  /* handle -> position in bytes */
+	std::vector<uint32_t> slots;    /* open addressing index of handles by hash, 0 is free */
+
+	string_table() : bytes(1, '\0'), offsets(1, 0), slots(64, 0) {}
+};
+
+static void string_table_grow(string_table& table) {
+	std::vector<uint32_t> slots(table.slots.size() * 2, 0);
+	size_t mask = slots.size() - 1;
+	for (uint32_t handle = 1; handle < table.offsets.size(); handle++) {
+		const char* value = table.bytes.c_str() + table.offsets[handle];
+		size_t slot = (size_t)hash_string(value, strlen(value)) & mask;
+		while (slots[slot]) slot = (slot + 1) & mask;
+		slots[slot] = handle;
+	}
+	table.slots.swap(slots);
+}
+
+/* Lookup or insert */
+uint32_t intern_string(string_table& table, const char* value, size_t length) {
+	if (length == 0) return STRING_HANDLE_EMPTY;
+	size_t mask = table.slots.size() - 1;
+	size_t slot = (size_t)hash_string(value, length) & mask;
+	while (uint32_t handle = table.slots[slot]) {
+		const char* known = table.bytes.c_str() + table.offsets[handle];
+		if (strncmp(known, value, length) == 0 && known[length] == '\0') return handle;
+		slot = (slot + 1) & mask;
+	}
+	uint32_t handle = (uint32_t)table.offsets.size();
+	table.offsets.push_back((uint32_t)table.bytes.size());
+	table.bytes.append(value, length);
+	table.bytes.push_back('\0');
+	table.slots[slot] = handle;
+	if (table.offsets.size() * 2 > table.slots.size()) string_table_grow(table);
+	return handle;
+}
+
+const char* interned_string(const string_table& table, uint32_t handle) {
+	return table.bytes.c_str() + table.offsets[handle];
+}
+
+/* The same value in another table */
+uint32_t reintern_string(string_table& target, const string_table& source, uint32_t handle) {
+	const char* value = interned_string(source, handle);
+	return intern_string(target, value, strlen(value));
+}
+
+size_t string_table_size(const string_table& table) {
+	return table.offsets.size() - 1;
+}
+
+size_t string_table_bytes(const string_table& table) {
+	return table.bytes.capacity() + table.offsets.capacity() * sizeof(uint32_t) + table.slots.capacity() * sizeof(uint32_t);
+}
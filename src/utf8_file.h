@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdio.h>
+#include <string>
+
+/*
+Files by UTF-8 path. The client hands out UTF-8 paths (config folder, avatars). On Windows the narrow CRT and the A
+functions read them in the ANSI code page, which breaks user profiles with other characters, so they are widened first.
+*/
+
+#ifdef _WIN32
+static std::wstring utf8_to_wide(const char* text) {
+	int length = MultiByteToWideChar(CP_UTF8, 0, text, -1, NULL, 0);
+	if (length <= 0) return std::wstring();
+	std::wstring wide(length, L'\0');
+	MultiByteToWideChar(CP_UTF8, 0, text, -1, &wide[0], length);
+	wide.resize(length - 1);  /* without the terminator */
+	return wide;
+}
+#endif
+
+static FILE* utf8_fopen(const std::string& path, const char* mode) {
+#ifdef _WIN32
+	return _wfopen(utf8_to_wide(path.c_str()).c_str(), utf8_to_wide(mode).c_str());
+#else
+	return fopen(path.c_str(), mode);
+#endif
+}
+
+/* Replaces to with from, on Windows written through before returning */
+static bool utf8_replace_file(const std::string& from, const std::string& to) {
+#ifdef _WIN32
+	return MoveFileExW(utf8_to_wide(from.c_str()).c_str(), utf8_to_wide(to.c_str()).c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+	return rename(from.c_str(), to.c_str()) == 0;
+#endif
+}
+
+static bool utf8_remove(const std::string& path) {
+#ifdef _WIN32
+	return _wremove(utf8_to_wide(path.c_str()).c_str()) == 0;
+#else
+	return remove(path.c_str()) == 0;
+#endif
+}
@@ -0,0 +1,387 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <math.h>
+#include <stdint.h>
+#include <string>
+
+#include "simd.h"
+
+/*
+Per-buffer level measurement of 16-bit voice data.
+Samples at or beyond CLIP_THRESHOLD (either sign) count as clipped.
+Debug builds also time every buffer for /kmi stats; release builds keep the audio callback free of clock reads.
+*/
+
+#ifdef _DEBUG
+#define KMI_METER_TIMING
+#endif
+
+#define CLIP_THRESHOLD 32767
+#define METER_SLOTS 1024
+#define METER_RELEASED 0xFFFFFFFFFFFFFFFFull  /* key of a slot given up; lookups probe past it, the audio thread reuses it */
+
+struct voice_levels {
+	uint64_t sum_squares;
+	int64_t sum;
+	uint32_t peak;
+	uint32_t clipped;
+	uint32_t samples;
+};
+
+static void measure_levels_scalar(const short* samples, int count, voice_levels* out) {
+	uint64_t sum_squares = 0;
+	int64_t sum = 0;
+	int peak = 0;
+	uint32_t clipped = 0;
+	for (int i = 0; i < count; i++) {
+		int s = samples[i];
+		int a = s < 0 ? -s : s;
+		sum_squares += (uint64_t)(s * s);
+		sum += s;
+		if (a > peak) peak = a;
+		if (a >= CLIP_THRESHOLD) clipped++;
+	}
+	out->sum_squares = sum_squares;
+	out->sum = sum;
+	out->peak = (uint32_t)peak;
+	out->clipped = clipped;
+	out->samples = (uint32_t)count;
+}
+
+#ifdef KMI_HAVE_SSE2
+/*
+_mm_madd_epi16 adds two squares per 32-bit lane. The largest possible pair sum is 2^31 (two samples of -32768),
+which only fits unsigned, so the lanes are zero-extended into the 64-bit accumulators.
+The clip counter (16 bit) and sample sum (32 bit) lanes get flushed once per block, before they can overflow.
+*/
+static void measure_levels_sse2(const short* samples, int count, voice_levels* out) {
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i ones = _mm_set1_epi16(1);
+	const __m128i clip_hi = _mm_set1_epi16(CLIP_THRESHOLD - 1);
+	const __m128i clip_lo = _mm_set1_epi16(-(CLIP_THRESHOLD - 1));
+	__m128i acc = zero;
+	__m128i vmax = zero;
+	__m128i vmin = zero;
+	uint64_t clipped = 0;
+	int64_t sum = 0;
+	int i = 0;
+
+	while (i + 8 <= count) {
+		__m128i clip_count = zero;
+		__m128i block_sum = zero;
+		int block_end = i + 8 * 16384;
+		if (block_end > count) block_end = count;
+		for (; i + 8 <= block_end; i += 8) {
+			__m128i v = _mm_loadu_si128((const __m128i*)(samples + i));
+			__m128i sq = _mm_madd_epi16(v, v);
+			acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(sq, zero));
+			acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(sq, zero));
+			block_sum = _mm_add_epi32(block_sum, _mm_madd_epi16(v, ones));
+			vmax = _mm_max_epi16(vmax, v);
+			vmin = _mm_min_epi16(vmin, v);
+			__m128i clip = _mm_or_si128(_mm_cmpgt_epi16(v, clip_hi), _mm_cmplt_epi16(v, clip_lo));
+			clip_count = _mm_sub_epi16(clip_count, clip);
+		}
+		__m128i c32 = _mm_madd_epi16(clip_count, ones);
+		uint32_t lanes[4];
+		_mm_storeu_si128((__m128i*)lanes, c32);
+		clipped += (uint64_t)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+		int32_t sum_lanes[4];
+		_mm_storeu_si128((__m128i*)sum_lanes, block_sum);
+		sum += (int64_t)sum_lanes[0] + sum_lanes[1] + sum_lanes[2] + sum_lanes[3];
+	}
+
+	uint64_t sums[2];
+	short maxs[8];
+	short mins[8];
+	_mm_storeu_si128((__m128i*)sums, acc);
+	_mm_storeu_si128((__m128i*)maxs, vmax);
+	_mm_storeu_si128((__m128i*)mins, vmin);
+	int peak = 0;
+	for (int l = 0; l < 8; l++) {
+		if (maxs[l] > peak) peak = maxs[l];
+		if (-mins[l] > peak) peak = -mins[l];
+	}
+
+	voice_levels tail;
+	measure_levels_scalar(samples + i, count - i, &tail);
+	out->sum_squares = sums[0] + sums[1] + tail.sum_squares;
+	out->sum = sum + tail.sum;
+	out->peak = (uint32_t)(peak > (int)tail.peak ? peak : (int)tail.peak);
+	out->clipped = (uint32_t)clipped + tail.clipped;
+	out->samples = (uint32_t)count;
+}
+
+KMI_TARGET_AVX2 static void measure_levels_avx2(const short* samples, int count, voice_levels* out) {
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i ones = _mm256_set1_epi16(1);
+	const __m256i clip_hi = _mm256_set1_epi16(CLIP_THRESHOLD - 1);
+	const __m256i clip_lo = _mm256_set1_epi16(-(CLIP_THRESHOLD - 1));
+	__m256i acc = zero;
+	__m256i vmax = zero;
+	__m256i vmin = zero;
+	uint64_t clipped = 0;
+	int64_t sum = 0;
+	int i = 0;
+
+	while (i + 16 <= count) {
+		__m256i clip_count = zero;
+		__m256i block_sum = zero;
+		int block_end = i + 16 * 16384;
+		if (block_end > count) block_end = count;
+		for (; i + 16 <= block_end; i += 16) {
+			__m256i v = _mm256_loadu_si256((const __m256i*)(samples + i));
+			__m256i sq = _mm256_madd_epi16(v, v);
+			acc = _mm256_add_epi64(acc, _mm256_unpacklo_epi32(sq, zero));
+			acc = _mm256_add_epi64(acc, _mm256_unpackhi_epi32(sq, zero));
+			block_sum = _mm256_add_epi32(block_sum, _mm256_madd_epi16(v, ones));
+			vmax = _mm256_max_epi16(vmax, v);
+			vmin = _mm256_min_epi16(vmin, v);
+			__m256i clip = _mm256_or_si256(_mm256_cmpgt_epi16(v, clip_hi), _mm256_cmpgt_epi16(clip_lo, v));
+			clip_count = _mm256_sub_epi16(clip_count, clip);
+		}
+		__m256i c32 = _mm256_madd_epi16(clip_count, ones);
+		uint32_t lanes[8];
+		_mm256_storeu_si256((__m256i*)lanes, c32);
+		int32_t sum_lanes[8];
+		_mm256_storeu_si256((__m256i*)sum_lanes, block_sum);
+		for (int l = 0; l < 8; l++) {
+			clipped += lanes[l];
+			sum += sum_lanes[l];
+		}
+	}
+
+	uint64_t sums[4];
+	short maxs[16];
+	short mins[16];
+	_mm256_storeu_si256((__m256i*)sums, acc);
+	_mm256_storeu_si256((__m256i*)maxs, vmax);
+	_mm256_storeu_si256((__m256i*)mins, vmin);
+	int peak = 0;
+	for (int l = 0; l < 16; l++) {
+		if (maxs[l] > peak) peak = maxs[l];
+		if (-mins[l] > peak) peak = -mins[l];
+	}
+
+	voice_levels tail;
+	measure_levels_scalar(samples + i, count - i, &tail);
+	out->sum_squares = sums[0] + sums[1] + sums[2] + sums[3] + tail.sum_squares;
+	out->sum = sum + tail.sum;
+	out->peak = (uint32_t)(peak > (int)tail.peak ? peak : (int)tail.peak);
+	out->clipped = (uint32_t)clipped + tail.clipped;
+	out->samples = (uint32_t)count;
+}
+
+static bool cpu_has_avx2() {
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) return false;
+	__cpuid(info, 1);
+	bool osxsave = (info[2] & (1 << 27)) != 0;
+	bool avx = (info[2] & (1 << 28)) != 0;
+	if (!osxsave || !avx) return false;
+	if ((_xgetbv(0) & 6) != 6) return false;  /* OS saves XMM and YMM state */
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+#endif
+
+typedef void(*measure_levels_fn)(const short*, int, voice_levels*);
+
+/* Resolved once in init_voice_meter, before any audio callback can run */
+static measure_levels_fn measure_levels = measure_levels_scalar;
+static const char* measure_levels_kernel = "scalar";
+
+/*
+One slot per (connection, client). The audio thread is the only writer of the totals and publishes them
+through a sequence counter, so the UI thread never blocks it and retries on a torn read instead.
+A slot is released when its client leaves view or the connection closes. Only the audio thread claims slots,
+and it zeroes the totals when it does, so a reused slot never shows the previous client's levels.
+*/
+struct client_meter {
+	std::atomic<uint64_t> key;
+	std::atomic<uint32_t> seq;
+	std::atomic<uint64_t> sum_squares;
+	std::atomic<uint64_t> samples;
+	std::atomic<uint64_t> clipped;
+	std::atomic<uint32_t> peak;
+};
+
+struct client_meter_reading {
+	uint64_t sum_squares;
+	uint64_t samples;
+	uint64_t clipped;
+	uint32_t peak;
+};
+
+static client_meter meters[METER_SLOTS];
+static std::atomic<uint64_t> meter_dropped(0);
+#ifdef KMI_METER_TIMING
+static std::atomic<uint64_t> meter_buffers(0);
+static std::atomic<uint64_t> meter_nanoseconds(0);
+static std::atomic<uint64_t> meter_max_nanoseconds(0);
+#endif
+
+static uint64_t meter_key(uint64 serverConnectionHandlerID, anyID clientID) {
+	return (serverConnectionHandlerID << 16) | clientID;
+}
+
+/* Audio thread */
+static bool claim_meter(client_meter* m, uint64_t expected, uint64_t key) {
+	if (!m->key.compare_exchange_strong(expected, key, std::memory_order_acq_rel)) return expected == key;
+	uint32_t seq = m->seq.load(std::memory_order_relaxed);
+	m->seq.store(seq + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	m->sum_squares.store(0, std::memory_order_relaxed);
+	m->samples.store(0, std::memory_order_relaxed);
+	m->clipped.store(0, std::memory_order_relaxed);
+	m->peak.store(0, std::memory_order_relaxed);
+	m->seq.store(seq + 2, std::memory_order_release);
+	return true;
+}
+
+/* Finds the slot for key, claiming a free or released one if create is set. Returns NULL if none is available. */
+static client_meter* find_meter(uint64_t key, bool create) {
+	size_t start = (size_t)((key * 0x9E3779B97F4A7C15ull) >> 54) % METER_SLOTS;
+	client_meter* released = NULL;
+	for (size_t n = 0; n < METER_SLOTS; n++) {
+		client_meter* m = &meters[(start + n) % METER_SLOTS];
+		uint64_t k = m->key.load(std::memory_order_acquire);
+		if (k == key) return m;
+		if (k == METER_RELEASED) {
+			if (!released) released = m;
+			continue;
+		}
+		if (k == 0) {
+			if (!create) return NULL;
+			/* The key is not further along the probe sequence, so the first released slot can take it */
+			if (released && claim_meter(released, METER_RELEASED, key)) return released;
+			if (claim_meter(m, 0, key)) return m;
+		}
+	}
+	if (create && released && claim_meter(released, METER_RELEASED, key)) return released;
+	return NULL;
+}
+
+void init_voice_meter() {
+#ifdef KMI_HAVE_SSE2
+	if (cpu_has_avx2()) {
+		measure_levels = measure_levels_avx2;
+		measure_levels_kernel = "avx2";
+	}
+	else {
+		measure_levels = measure_levels_sse2;
+		measure_levels_kernel = "sse2";
+	}
+#endif
+}
+
+/* Audio thread. No locks, no allocation. */
+void meter_voice_data(uint64 serverConnectionHandlerID, anyID clientID, const short* samples, int sampleCount, int channels) {
+#ifdef KMI_METER_TIMING
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+#endif
+
+	client_meter* m = find_meter(meter_key(serverConnectionHandlerID, clientID), true);
+	if (!m) {
+		meter_dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	voice_levels levels;
+	measure_levels(samples, sampleCount * channels, &levels);
+
+	uint32_t seq = m->seq.load(std::memory_order_relaxed);
+	m->seq.store(seq + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	m->sum_squares.store(m->sum_squares.load(std::memory_order_relaxed) + levels.sum_squares, std::memory_order_relaxed);
+	m->samples.store(m->samples.load(std::memory_order_relaxed) + levels.samples, std::memory_order_relaxed);
+	m->clipped.store(m->clipped.load(std::memory_order_relaxed) + levels.clipped, std::memory_order_relaxed);
+	if (levels.peak > m->peak.load(std::memory_order_relaxed)) m->peak.store(levels.peak, std::memory_order_relaxed);
+	m->seq.store(seq + 2, std::memory_order_release);
+
+#ifdef KMI_METER_TIMING
+	uint64_t ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+	meter_buffers.fetch_add(1, std::memory_order_relaxed);
+	meter_nanoseconds.fetch_add(ns, std::memory_order_relaxed);
+	uint64_t max_ns = meter_max_nanoseconds.load(std::memory_order_relaxed);
+	while (ns > max_ns && !meter_max_nanoseconds.compare_exchange_weak(max_ns, ns, std::memory_order_relaxed)) {}
+#endif
+}
+
+static void release_meter(client_meter* m, uint64_t key) {
+	m->key.compare_exchange_strong(key, METER_RELEASED, std::memory_order_acq_rel);
+}
+
+/* Client left our view */
+void release_voice_meter(uint64 serverConnectionHandlerID, anyID clientID) {
+	uint64_t key = meter_key(serverConnectionHandlerID, clientID);
+	client_meter* m = find_meter(key, false);
+	if (m) release_meter(m, key);
+}
+
+/* Every client of a closed connection */
+void release_connection_meters(uint64 serverConnectionHandlerID) {
+	for (size_t i = 0; i < METER_SLOTS; i++) {
+		uint64_t key = meters[i].key.load(std::memory_order_acquire);
+		if (key != 0 && key != METER_RELEASED && key >> 16 == serverConnectionHandlerID) release_meter(&meters[i], key);
+	}
+}
+
+bool read_voice_meter(uint64 serverConnectionHandlerID, anyID clientID, client_meter_reading* out) {
+	uint64_t key = meter_key(serverConnectionHandlerID, clientID);
+	client_meter* m = find_meter(key, false);
+	if (!m) return false;
+	for (int attempt = 0; attempt < 64; attempt++) {
+		uint32_t before = m->seq.load(std::memory_order_acquire);
+		if (before & 1) continue;
+		out->sum_squares = m->sum_squares.load(std::memory_order_relaxed);
+		out->samples = m->samples.load(std::memory_order_relaxed);
+		out->clipped = m->clipped.load(std::memory_order_relaxed);
+		out->peak = m->peak.load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (m->seq.load(std::memory_order_relaxed) == before) {
+			/* Released or claimed by another client meanwhile */
+			if (m->key.load(std::memory_order_acquire) != key) return false;
+			return out->samples > 0;
+		}
+	}
+	return false;
+}
+
+static double level_dbfs(double amplitude) {
+	if (amplitude <= 0.0) return -96.0;
+	return 20.0 * log10(amplitude / 32768.0);
+}
+
+std::string voice_meter_string(uint64 serverConnectionHandlerID, anyID clientID) {
+	client_meter_reading r;
+	if (!read_voice_meter(serverConnectionHandlerID, clientID, &r)) {
+		return "no voice data yet";
+	}
+	double rms = sqrt((double)r.sum_squares / (double)r.samples);
+	double clip_percent = 100.0 * (double)r.clipped / (double)r.samples;
+	char buffer[96];
+	snprintf(buffer, sizeof(buffer), "%.1f dBFS / %.2f %% clipping (peak %.1f dBFS)", level_dbfs(rms), clip_percent, level_dbfs(r.peak));
+	return buffer;
+}
+
+std::string voice_meter_cost_string() {
+#ifndef KMI_METER_TIMING
+	return std::string(measure_levels_kernel) + " kernel, " + std::to_string(meter_dropped.load(std::memory_order_relaxed)) + " dropped";
+#else
+	uint64_t buffers = meter_buffers.load(std::memory_order_relaxed);
+	uint64_t avg = buffers ? meter_nanoseconds.load(std::memory_order_relaxed) / buffers : 0;
+	char buffer[128];
+	snprintf(buffer, sizeof(buffer), "%s kernel, %llu buffers, avg %llu ns, max %llu ns, %llu dropped",
+		measure_levels_kernel, (unsigned long long)buffers, (unsigned long long)avg,
+		(unsigned long long)meter_max_nanoseconds.load(std::memory_order_relaxed), (unsigned long long)meter_dropped.load(std::memory_order_relaxed));
+	return buffer;
+#endif
+}
@@ -0,0 +1,177 @@
+/*
+Tests of the history exchange wire format (src/exchange_codec.h). Needs nothing but the SDK headers:
+	g++ -std=c++14 -Iinclude test/exchange_codec_test.cpp -o exchange_codec_test && ./exchange_codec_test
+	cl /EHsc /Iinclude test\exchange_codec_test.cpp && exchange_codec_test.exe
+Prints every failed check and exits with 1 if there was one.
+*/
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "teamspeak/public_definitions.h"
+#include "../src/exchange_codec.h"
+
+static int failures = 0;
+
+#define CHECK(condition) do { if (!(condition)) { printf("%s:%d: %s\n", __FILE__, __LINE__, #condition); failures++; } } while (0)
+
+static const long long NOW = 1700000000;
+
+static exchange_entry make_entry(anyID client, long long first_seen, long long previous_visit, unsigned int visits) {
+	exchange_entry entry = { client, first_seen, previous_visit, visits };
+	return entry;
+}
+
+/* Base64 of raw message bytes behind the prefix, for hand made messages */
+static std::string raw_command(const std::string& message) {
+	return EXCHANGE_PREFIX + base64_encode(message);
+}
+
+static void test_request_round_trip() {
+	std::vector<anyID> clients;
+	clients.push_back(2);
+	clients.push_back(3);
+	clients.push_back(700);
+	clients.push_back(65535);
+	size_t asked;
+	std::string command = encode_exchange_request(17, clients, asked);
+	CHECK(asked == clients.size());
+	exchange_message message;
+	CHECK(decode_exchange_command(command.c_str(), message));
+	CHECK(message.type == EXCHANGE_REQUEST);
+	CHECK(message.sender == 17);
+	CHECK(message.clients == clients);
+}
+
+static void test_answer_round_trip() {
+	std::vector<exchange_entry> entries;
+	entries.push_back(make_entry(5, NOW - 86400 * 400, NOW - 3600, 12));
+	entries.push_back(make_entry(9, NOW - 60, 0, 1));
+	entries.push_back(make_entry(40000, NOW, NOW, 4000000000u));
+	size_t answered;
+	std::string command = encode_exchange_answer(3, NOW, entries, answered);
+	CHECK(answered == entries.size());
+	exchange_message message;
+	CHECK(decode_exchange_command(command.c_str(), message));
+	CHECK(message.type == EXCHANGE_ANSWER);
+	CHECK(message.sender == 3);
+	CHECK(message.base == NOW);
+	CHECK(message.entries.size() == entries.size());
+	for (size_t i = 0; i < entries.size() && i < message.entries.size(); i++) {
+		CHECK(message.entries[i].client == entries[i].client);
+		CHECK(message.entries[i].first_seen == entries[i].first_seen);
+		CHECK(message.entries[i].previous_visit == entries[i].previous_visit);
+		CHECK(message.entries[i].visits == entries[i].visits);
+	}
+}
+
+static void test_truncation() {
+	/* Spread out IDs take three bytes each, far more than fit */
+	std::vector<anyID> clients;
+	for (unsigned int i = 1; i <= 2000; i++) clients.push_back((anyID)(i * 30));
+	size_t asked;
+	std::string request = encode_exchange_request(1, clients, asked);
+	CHECK(asked > 0 && asked < clients.size());
+	CHECK(request.size() <= EXCHANGE_MAX_COMMAND_BYTES);
+	exchange_message message;
+	CHECK(decode_exchange_command(request.c_str(), message));
+	CHECK(message.clients == std::vector<anyID>(clients.begin(), clients.begin() + asked));
+
+	std::vector<exchange_entry> entries;
+	for (unsigned int i = 1; i <= 2000; i++) entries.push_back(make_entry((anyID)(i * 30), NOW - i * 86400LL, NOW - i, i * 1000));
+	size_t answered;
+	std::string answer = encode_exchange_answer(1, NOW, entries, answered);
+	CHECK(answered > 0 && answered < entries.size());
+	CHECK(answer.size() <= EXCHANGE_MAX_COMMAND_BYTES);
+	CHECK(decode_exchange_command(answer.c_str(), message));
+	CHECK(message.entries.size() == answered);
+	CHECK(!message.entries.empty() && message.entries.back().client == entries[answered - 1].client);
+}
+
+static void test_bad_base64() {
+	exchange_message message;
+	CHECK(!decode_exchange_command("kmi:AQ*C", message));
+	CHECK(!decode_exchange_command("kmi:AQEBA", message));  /* a single digit left over */
+	CHECK(!decode_exchange_command("kmi:", message));
+	CHECK(!decode_exchange_command("other:AQEBAA==", message));
+}
+
+static void test_wrong_version() {
+	std::vector<anyID> clients(1, 5);
+	size_t asked;
+	std::string command = encode_exchange_request(2, clients, asked);
+	std::string message;
+	CHECK(base64_decode(command.c_str() + sizeof(EXCHANGE_PREFIX) - 1, message));
+	message[0] = EXCHANGE_VERSION + 1;
+	exchange_message decoded;
+	CHECK(!decode_exchange_command(raw_command(message).c_str(), decoded));
+	message[0] = EXCHANGE_VERSION;
+	message[1] = 3;  /* unknown type */
+	CHECK(!decode_exchange_command(raw_command(message).c_str(), decoded));
+	message[1] = EXCHANGE_REQUEST;
+	CHECK(decode_exchange_command(raw_command(message).c_str(), decoded));
+	CHECK(!decode_exchange_command(raw_command(message + '\0').c_str(), decoded));  /* trailing byte */
+}
+
+static void test_varint_overflow() {
+	std::string header;
+	header += (char)EXCHANGE_VERSION;
+	header += (char)EXCHANGE_REQUEST;
+	exchange_message decoded;
+
+	std::string sender = header + std::string(11, (char)0xFF) + '\x01';  /* more than 64 bits */
+	CHECK(!decode_exchange_command(raw_command(sender).c_str(), decoded));
+	std::string wide = header + std::string(9, (char)0xFF) + '\x02';  /* bit 64 set in the tenth byte */
+	CHECK(!decode_exchange_command(raw_command(wide).c_str(), decoded));
+	std::string client = header + '\x05' + '\x01' + "\xFF\xFF\x04";  /* client ID difference above 65535 */
+	CHECK(!decode_exchange_command(raw_command(client).c_str(), decoded));
+	std::string cut = header + '\x05' + '\x02' + '\x01';  /* count 2, one client */
+	CHECK(!decode_exchange_command(raw_command(cut).c_str(), decoded));
+
+	std::string answer;
+	answer += (char)EXCHANGE_VERSION;
+	answer += (char)EXCHANGE_ANSWER;
+	answer += '\x05';
+	put_varint(answer, 100);  /* base */
+	put_varint(answer, 1);
+	answer += '\x07';
+	put_varint(answer, 101);  /* first seen before time 0 */
+	put_varint(answer, 0);
+	put_varint(answer, 1);
+	CHECK(!decode_exchange_command(raw_command(answer).c_str(), decoded));
+}
+
+static void test_loopback() {
+	std::vector<anyID> clients;
+	std::vector<exchange_entry> history;
+	for (anyID i = 1; i <= 400; i++) {
+		clients.push_back((anyID)(i * 3));
+		if (i % 2 == 0) history.push_back(make_entry((anyID)(i * 3), NOW - i * 86400LL, i % 4 ? NOW - i * 3600LL : 0, i));
+	}
+	exchange_loopback_result result = run_exchange_loopback(clients, history, NOW);
+	CHECK(result.decoded);
+	CHECK(result.asked == clients.size());
+	CHECK(result.answered > 0 && result.answered <= history.size());
+	CHECK(result.request_bytes <= EXCHANGE_MAX_COMMAND_BYTES && result.answer_bytes <= EXCHANGE_MAX_COMMAND_BYTES);
+
+	std::vector<exchange_entry> none;
+	result = run_exchange_loopback(clients, none, NOW);
+	CHECK(result.decoded && result.answered == 0);
+}
+
+int main() {
+	test_request_round_trip();
+	test_answer_round_trip();
+	test_truncation();
+	test_bad_base64();
+	test_wrong_version();
+	test_varint_overflow();
+	test_loopback();
+	if (failures) {
+		printf("%d checks failed\n", failures);
+		return 1;
+	}
+	printf("all checks passed\n");
+	return 0;
+}
@@ -0,0 +1,299 @@
+/*
+Stress test of the threading model (see plugin.cpp): info panels, client and channel events, voice data, layout
+reloads and badge republishing from several threads at once, against a stub client. Meant for ThreadSanitizer:
+	g++ -std=c++14 -g -O1 -fsanitize=thread -Iinclude test/plugin_threads_test.cpp -o plugin_threads_test -lpthread
+	./plugin_threads_test [rounds]
+The plugin's files (layout, settings, sightings log, snapshots) go to the current directory, run it in an empty one.
+TSan prints every race it sees and makes the exit code non-zero; the test itself exits with 1 if a panel came back
+empty.
+*/
+
+#include <atomic>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../src/plugin.cpp"
+
+static int failures = 0;
+
+#define CHECK(condition) do { if (!(condition)) { printf("%s:%d: %s\n", __FILE__, __LINE__, #condition); failures++; } } while (0)
+
+#define STUB_CONNECTION 1
+#define STUB_CLIENTS 64
+#define STUB_CHANNELS 8
+
+/* The stub client answers from fixed values only, so every race TSan reports is the plugin's */
+
+static char* stub_string(const std::string& value) {
+	char* result = (char*)malloc(value.size() + 1);
+	memcpy(result, value.c_str(), value.size() + 1);
+	return result;
+}
+
+static unsigned int stub_free(void* pointer) {
+	free(pointer);
+	return ERROR_ok;
+}
+
+static unsigned int stub_log(const char* message, enum LogLevel severity, const char* channel, uint64 logID) {
+	return ERROR_ok;
+}
+
+static void stub_path(char* path, size_t size) {
+	_strcpy(path, size, "./");
+}
+
+static void stub_plugin_path(char* path, size_t size, const char* pluginID) {
+	_strcpy(path, size, "./");
+}
+
+static uint64 stub_current_connection() {
+	return STUB_CONNECTION;
+}
+
+static unsigned int stub_connections(uint64** result) {
+	*result = (uint64*)malloc(2 * sizeof(uint64));
+	(*result)[0] = STUB_CONNECTION;
+	(*result)[1] = 0;
+	return ERROR_ok;
+}
+
+static unsigned int stub_status(uint64 serverConnectionHandlerID, int* result) {
+	*result = STATUS_CONNECTION_ESTABLISHED;
+	return ERROR_ok;
+}
+
+static unsigned int stub_own_id(uint64 serverConnectionHandlerID, anyID* result) {
+	*result = 1;
+	return ERROR_ok;
+}
+
+static unsigned int stub_clients(uint64 serverConnectionHandlerID, anyID** result) {
+	*result = (anyID*)malloc((STUB_CLIENTS + 1) * sizeof(anyID));
+	for (anyID i = 0; i < STUB_CLIENTS; i++) (*result)[i] = (anyID)(i + 1);
+	(*result)[STUB_CLIENTS] = 0;
+	return ERROR_ok;
+}
+
+static unsigned int stub_channels(uint64 serverConnectionHandlerID, uint64** result) {
+	*result = (uint64*)malloc((STUB_CHANNELS + 1) * sizeof(uint64));
+	for (uint64 i = 0; i < STUB_CHANNELS; i++) (*result)[i] = i + 1;
+	(*result)[STUB_CHANNELS] = 0;
+	return ERROR_ok;
+}
+
+static unsigned int stub_channel_of_client(uint64 serverConnectionHandlerID, anyID clientID, uint64* result) {
+	*result = clientID % STUB_CHANNELS + 1;
+	return ERROR_ok;
+}
+
+static unsigned int stub_client_string(uint64 serverConnectionHandlerID, anyID clientID, size_t flag, char** result) {
+	std::string id = std::to_string(clientID);
+	switch (flag) {
+	case CLIENT_NICKNAME: *result = stub_string("client [b]" + id + "[/b]"); break;
+	case CLIENT_UNIQUE_IDENTIFIER: *result = stub_string("uid" + id + "="); break;
+	case CLIENT_BADGES: *result = stub_string("overwolf=0:badges=1cb07348-34a4-4741-b50f-c41e584370f7,450f81c1-ab41-4211-a338-222fa94ed157"); break;
+	default: *result = stub_string("value " + id); break;
+	}
+	return ERROR_ok;
+}
+
+static unsigned int stub_client_int(uint64 serverConnectionHandlerID, anyID clientID, size_t flag, int* result) {
+	*result = clientID;
+	return ERROR_ok;
+}
+
+static unsigned int stub_client_uint64(uint64 serverConnectionHandlerID, anyID clientID, size_t flag, uint64* result) {
+	*result = 1700000000 + clientID;
+	return ERROR_ok;
+}
+
+static unsigned int stub_channel_string(uint64 serverConnectionHandlerID, uint64 channelID, size_t flag, char** result) {
+	*result = stub_string("channel [i]" + std::to_string(channelID) + "[/i]");
+	return ERROR_ok;
+}
+
+static unsigned int stub_channel_int(uint64 serverConnectionHandlerID, uint64 channelID, size_t flag, int* result) {
+	*result = (int)channelID;
+	return ERROR_ok;
+}
+
+static unsigned int stub_channel_uint64(uint64 serverConnectionHandlerID, uint64 channelID, size_t flag, uint64* result) {
+	*result = channelID;
+	return ERROR_ok;
+}
+
+static unsigned int stub_server_string(uint64 serverConnectionHandlerID, size_t flag, char** result) {
+	switch (flag) {
+	case VIRTUALSERVER_UNIQUE_IDENTIFIER: *result = stub_string("server-uid="); break;
+	case VIRTUALSERVER_WELCOMEMESSAGE: *result = stub_string("Welcome [b]home[/b]\n\tread the [url=x]rules[/url]"); break;
+	default: *result = stub_string("server value"); break;
+	}
+	return ERROR_ok;
+}
+
+static unsigned int stub_server_int(uint64 serverConnectionHandlerID, size_t flag, int* result) {
+	*result = 1;
+	return ERROR_ok;
+}
+
+static unsigned int stub_server_uint64(uint64 serverConnectionHandlerID, size_t flag, uint64* result) {
+	*result = 1700000000;
+	return ERROR_ok;
+}
+
+static unsigned int stub_request_server(uint64 serverConnectionHandlerID) {
+	return ERROR_ok;
+}
+
+static unsigned int stub_request_client(uint64 serverConnectionHandlerID, anyID clientID, const char* returnCode) {
+	return ERROR_ok;
+}
+
+static unsigned int stub_request_description(uint64 serverConnectionHandlerID, uint64 channelID, const char* returnCode) {
+	return ERROR_ok;
+}
+
+static unsigned int stub_request_files(uint64 serverConnectionHandlerID, uint64 channelID, const char* channelPW, const char* path, const char* returnCode) {
+	return ERROR_ok;
+}
+
+static unsigned int stub_send_command(uint64 serverConnectionHandlerID, const char* pluginID, const char* command, int targetMode, const anyID* targetIDs, const char* returnCode) {
+	return ERROR_ok;
+}
+
+static unsigned int stub_avatar(uint64 serverConnectionHandlerID, anyID clientID, char* result, size_t maxLen) {
+	return ERROR_undefined;
+}
+
+static void stub_print(const char* message) {
+}
+
+static void stub_print_to(uint64 serverConnectionHandlerID, const char* message, enum PluginMessageTarget messageTarget) {
+}
+
+static void stub_info_update(uint64 serverConnectionHandlerID, enum PluginItemType type, uint64 itemID) {
+}
+
+static std::atomic<int> return_codes(0);
+
+static void stub_return_code(const char* pluginID, char* returnCode, size_t maxLen) {
+	snprintf(returnCode, maxLen, "stub_%d", return_codes.fetch_add(1));
+}
+
+static struct TS3Functions stub_client() {
+	struct TS3Functions funcs;
+	memset(&funcs, 0, sizeof(funcs));
+	funcs.freeMemory = stub_free;
+	funcs.logMessage = stub_log;
+	funcs.getAppPath = stub_path;
+	funcs.getResourcesPath = stub_path;
+	funcs.getConfigPath = stub_path;
+	funcs.getPluginPath = stub_plugin_path;
+	funcs.getCurrentServerConnectionHandlerID = stub_current_connection;
+	funcs.getServerConnectionHandlerList = stub_connections;
+	funcs.getConnectionStatus = stub_status;
+	funcs.getClientID = stub_own_id;
+	funcs.getClientList = stub_clients;
+	funcs.getChannelList = stub_channels;
+	funcs.getChannelOfClient = stub_channel_of_client;
+	funcs.getClientVariableAsString = stub_client_string;
+	funcs.getClientVariableAsInt = stub_client_int;
+	funcs.getClientVariableAsUInt64 = stub_client_uint64;
+	funcs.getChannelVariableAsString = stub_channel_string;
+	funcs.getChannelVariableAsInt = stub_channel_int;
+	funcs.getChannelVariableAsUInt64 = stub_channel_uint64;
+	funcs.getServerVariableAsString = stub_server_string;
+	funcs.getServerVariableAsInt = stub_server_int;
+	funcs.getServerVariableAsUInt64 = stub_server_uint64;
+	funcs.requestServerVariables = stub_request_server;
+	funcs.requestClientVariables = stub_request_client;
+	funcs.requestChannelDescription = stub_request_description;
+	funcs.requestFileList = stub_request_files;
+	funcs.sendPluginCommand = stub_send_command;
+	funcs.getAvatar = stub_avatar;
+	funcs.printMessageToCurrentTab = stub_print;
+	funcs.printMessage = stub_print_to;
+	funcs.requestInfoUpdate = stub_info_update;
+	funcs.createReturnCode = stub_return_code;
+	return funcs;
+}
+
+static std::atomic<int> empty_panels(0);
+
+static void render_panels(int rounds) {
+	for (int r = 0; r < rounds; r++) {
+		char* data = NULL;
+		PluginItemType type = (PluginItemType)(r % 3);
+		uint64 id = type == PLUGIN_SERVER ? 0 : type == PLUGIN_CHANNEL ? (uint64)(r % STUB_CHANNELS + 1) : (uint64)(r % STUB_CLIENTS + 1);
+		ts3plugin_infoData(STUB_CONNECTION, id, type, &data);
+		if (!data || !*data) empty_panels.fetch_add(1);
+		if (data) ts3plugin_freeMemory(data);
+	}
+}
+
+static void move_clients(int rounds) {
+	for (int r = 0; r < rounds; r++) {
+		anyID client = (anyID)(r % STUB_CLIENTS + 2);
+		uint64 channel = (uint64)(r % STUB_CHANNELS + 1);
+		switch (r % 4) {
+		case 0: ts3plugin_onClientMoveEvent(STUB_CONNECTION, client, 0, channel, ENTER_VISIBILITY, ""); break;
+		case 1: ts3plugin_onClientMoveMovedEvent(STUB_CONNECTION, client, channel, channel % STUB_CHANNELS + 1, RETAIN_VISIBILITY, 1, "mover", "mover=", ""); break;
+		case 2: ts3plugin_onClientMoveSubscriptionEvent(STUB_CONNECTION, client, channel, 0, LEAVE_VISIBILITY); break;
+		default: ts3plugin_onClientMoveEvent(STUB_CONNECTION, client, channel, 0, LEAVE_VISIBILITY, "bye"); break;
+		}
+	}
+}
+
+static void update_variables(int rounds) {
+	for (int r = 0; r < rounds; r++) {
+		ts3plugin_onUpdateClientEvent(STUB_CONNECTION, (anyID)(r % STUB_CLIENTS + 1), 1, "editor", "editor=");
+		ts3plugin_onUpdateChannelEditedEvent(STUB_CONNECTION, (uint64)(r % STUB_CHANNELS + 1), 1, "editor", "editor=");
+		if (r % 8 == 0) ts3plugin_onServerUpdatedEvent(STUB_CONNECTION);
+	}
+}
+
+static void play_voice(int rounds) {
+	std::vector<short> samples(960 * 2);
+	for (size_t i = 0; i < samples.size(); i++) samples[i] = (short)(i * 37);
+	for (int r = 0; r < rounds; r++) {
+		ts3plugin_onEditPlaybackVoiceDataEvent(STUB_CONNECTION, (anyID)(r % STUB_CLIENTS + 1), &samples[0], 960, 2);
+	}
+}
+
+/* Layout and badge names are republished as snapshots while the panels read them */
+static void reload_snapshots(int rounds) {
+	for (int r = 0; r < rounds / 16; r++) {
+		ts3plugin_processCommand(STUB_CONNECTION, "reload");
+		init_guids();
+	}
+}
+
+int main(int argc, char** argv) {
+	int rounds = argc > 1 ? atoi(argv[1]) : 2000;
+	ts3plugin_setFunctionPointers(stub_client());
+	ts3plugin_registerPluginID("stub_plugin");
+	CHECK(ts3plugin_init() == 0);
+
+	std::vector<std::thread> threads;
+	threads.push_back(std::thread(render_panels, rounds));
+	threads.push_back(std::thread(render_panels, rounds));
+	threads.push_back(std::thread(move_clients, rounds));
+	threads.push_back(std::thread(update_variables, rounds));
+	threads.push_back(std::thread(play_voice, rounds));
+	threads.push_back(std::thread(reload_snapshots, rounds));
+	for (size_t i = 0; i < threads.size(); i++) threads[i].join();
+
+	ts3plugin_shutdown();
+	CHECK(empty_panels.load() == 0);
+	if (failures) {
+		printf("%d checks failed\n", failures);
+		return 1;
+	}
+	printf("all checks passed\n");
+	return 0;
+}
@@ -0,0 +1,97 @@
+/*
+Benchmark of the voice level kernels (src/voice_meter.h) on the buffers the client hands to
+onEditPlaybackVoiceDataEvent: 10 and 20 ms of 48 kHz audio, mono and stereo. Needs nothing but the SDK headers:
+	g++ -std=c++14 -O2 -Iinclude test/voice_meter_bench.cpp -o voice_meter_bench && ./voice_meter_bench
+	cl /O2 /EHsc /Iinclude test\voice_meter_bench.cpp && voice_meter_bench.exe
+Exits with 1 if the kernels disagree on any buffer.
+*/
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "teamspeak/public_definitions.h"
+#include "../src/voice_meter.h"
+
+struct bench_kernel {
+	const char* name;
+	measure_levels_fn measure;
+};
+
+static bool same_levels(const voice_levels& a, const voice_levels& b) {
+	return a.sum_squares == b.sum_squares && a.sum == b.sum && a.peak == b.peak && a.clipped == b.clipped &&
+		a.samples == b.samples;
+}
+
+/* Nanoseconds per buffer */
+static double time_kernel(measure_levels_fn measure, const std::vector<short>& samples, int rounds) {
+	voice_levels levels;
+	uint64_t sink = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int r = 0; r < rounds; r++) {
+		measure(&samples[0], (int)samples.size(), &levels);
+		sink += levels.sum_squares;
+	}
+	std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - start;
+	if (sink == 1) printf(" ");  /* keeps the loop */
+	return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / rounds;
+}
+
+/* Nanoseconds per meter_voice_data call, slot lookup and publishing included */
+static double time_meter(const std::vector<short>& samples, int sample_count, int channels, int rounds) {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (int r = 0; r < rounds; r++) meter_voice_data(1, (anyID)(r % 32 + 1), &samples[0], sample_count, channels);
+	std::chrono::steady_clock::duration elapsed = std::chrono::steady_clock::now() - start;
+	return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / rounds;
+}
+
+int main() {
+	std::vector<bench_kernel> kernels;
+	kernels.push_back(bench_kernel{ "scalar", measure_levels_scalar });
+#ifdef KMI_HAVE_SSE2
+	kernels.push_back(bench_kernel{ "sse2", measure_levels_sse2 });
+	if (cpu_has_avx2()) kernels.push_back(bench_kernel{ "avx2", measure_levels_avx2 });
+	else printf("no AVX2 on this CPU, its kernel is skipped\n");
+#endif
+	init_voice_meter();
+
+	const int sample_counts[] = { 480, 960 };  /* 10 and 20 ms at 48 kHz */
+	const int rounds = 200000;
+	int failures = 0;
+	srand(1);
+
+	printf("%-8s %8s", "samples", "channels");
+	for (size_t k = 0; k < kernels.size(); k++) printf(" %9s ns", kernels[k].name);
+	printf(" %15s %10s\n", "callback ns", "of budget");
+	for (int s = 0; s < 2; s++) {
+		for (int channels = 1; channels <= 2; channels++) {
+			int sample_count = sample_counts[s];
+			std::vector<short> samples((size_t)(sample_count * channels));
+			for (size_t i = 0; i < samples.size(); i++) samples[i] = (short)(rand() % 65536 - 32768);
+			samples[samples.size() / 2] = -32768;  /* one clipped sample each sign */
+			samples[samples.size() / 3] = 32767;
+
+			voice_levels reference;
+			measure_levels_scalar(&samples[0], (int)samples.size(), &reference);
+			printf("%-8d %8d", sample_count, channels);
+			for (size_t k = 0; k < kernels.size(); k++) {
+				voice_levels levels;
+				kernels[k].measure(&samples[0], (int)samples.size(), &levels);
+				if (!same_levels(levels, reference)) {
+					printf(" %12s", "DIFFERS");
+					failures++;
+					continue;
+				}
+				time_kernel(kernels[k].measure, samples, rounds / 10);  /* warm up */
+				printf(" %12.0f", time_kernel(kernels[k].measure, samples, rounds));
+			}
+			double callback_ns = time_meter(samples, sample_count, channels, rounds);
+			double budget_ns = sample_count * 1e9 / 48000;
+			printf(" %15.0f %9.4f%%\n", callback_ns, callback_ns * 100 / budget_ns);
+		}
+	}
+	printf("callback runs the %s kernel, the budget is the buffer's playback time\n", measure_levels_kernel);
+	return failures ? 1 : 0;
+}